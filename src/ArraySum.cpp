@@ -0,0 +1,247 @@
+#include "ArraySum.hpp"
+#include "vkn.hpp"
+#include "vkn_profiler.hpp"
+#include "StagingBuffer.hpp"
+#include "Buffer.hpp"
+#include "ComputePipelineVariants.hpp"
+#include "FrameGraph.hpp"
+#include "ReadbackRing.hpp"
+#include "HostArraySum.hpp"
+#include "defines.hpp"
+
+#include <string.h>
+#include <algorithm>
+
+ArraySum::ArraySum( const uint32_t _slot_count, const uint32_t _queue_family_index, const VkQueue upload_queue, const uint32_t _upload_queue_family_index, const uint32_t _element_capacity, const uint32_t _slots_per_input )
+    : slot_count { _slot_count }
+    , slots_per_input { _slots_per_input }
+    , queue_family_index { _queue_family_index }
+    , upload_queue_family_index { _upload_queue_family_index }
+    , element_capacity { _element_capacity }
+{
+    assert( slot_count > 0 );
+    ASSERT( slots_per_input > 0 && slot_count % slots_per_input == 0, "ArraySum slot count %u is not a multiple of the slots per input %u!\n", slot_count, slots_per_input );
+
+    const VkPhysicalDeviceSubgroupProperties& subgroup_props = vkn::get_physical_device_subgroup_properties();
+    ASSERT( ( subgroup_props.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT ) && ( subgroup_props.supportedOperations & VK_SUBGROUP_FEATURE_ARITHMETIC_BIT ),
+        "array_sum requires subgroup arithmetic in compute shaders!\n" );
+
+    assert( element_capacity > 0 );
+
+    // The input repeats every 256 elements, so one block is uploaded over and over instead of holding the whole array
+    host_input.resize( input_block_element_count );
+    for ( uint32_t i = 0; i < input_block_element_count; i++ )
+    {
+        host_input[i] = HostArraySum::get_input_element( i );
+    }
+
+    set_element_count( element_capacity );
+
+    // The input is larger than the ring, StagingBuffer streams it through in chunks
+    staging_buffer = std::make_unique<StagingBuffer>( upload_queue, upload_queue_family_index, ( 1 << 20 ) * 8 );
+
+    init_resources();
+}
+
+ArraySum::~ArraySum()
+{
+    // Uploads may still be copying into the input buffers that are about to be destroyed
+    staging_buffer->wait_idle();
+
+    pipeline_variants.reset();
+}
+
+void ArraySum::init_resources()
+{
+    const uint32_t input_count = slot_count / slots_per_input;
+
+    device_local_input_buffers.reserve( input_count );
+    device_local_output_buffers.reserve( slot_count );
+    pending_acquire_barriers.resize( input_count );
+
+    for ( uint32_t i = 0; i < input_count; i++ )
+        device_local_input_buffers.push_back( std::make_unique<const Buffer>( VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, static_cast<VkDeviceSize>( element_capacity ) * sizeof( uint32_t ) ) );
+    for ( uint32_t i = 0; i < slot_count; i++ )
+        device_local_output_buffers.push_back( std::make_unique<const Buffer>( VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sizeof( uint32_t ) ) );
+
+    readback_ring = std::make_unique<ReadbackRing>( slot_count, sizeof( uint32_t ) );
+
+    pipeline_variants = std::make_unique<ComputePipelineVariants>( kernel_name, vkn::get_push_constant_pipeline_layout() );
+    set_specialization( vkn::select_compute_specialization( kernel_name ) );
+
+    slot_graphs.reserve( slot_count );
+    for ( uint32_t i = 0; i < slot_count; i++ )
+        slot_graphs.push_back( build_slot_graph( i ) );
+}
+
+std::unique_ptr<FrameGraph> ArraySum::build_slot_graph( const uint32_t slot )
+{
+    const Buffer& device_local_input_buffer = *device_local_input_buffers.at( get_input_index( slot ) );
+    const Buffer& device_local_output_buffer = *device_local_output_buffers.at( slot );
+
+    std::unique_ptr<FrameGraph> graph = std::make_unique<FrameGraph>();
+
+    const FrameGraph::ResourceId input = graph->import_buffer( "input", device_local_input_buffer, false );
+    const FrameGraph::ResourceId output = graph->import_buffer( "output", device_local_output_buffer, false );
+    // The slot's buffer of the readback ring, read once the submission has completed
+    const Buffer& host_output_buffer = readback_ring->get_buffer( slot );
+    const FrameGraph::ResourceId host_output = graph->import_buffer( "host output", host_output_buffer, true, VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT );
+
+    // clear the slot's accumulator, no staging upload required
+    graph->add_pass( "clear", {}, { { output, VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT } },
+        [buffer = device_local_output_buffer.buffer]( const VkCommandBuffer cmd_buff ) {
+            vkCmdFillBuffer( cmd_buff, buffer, 0, sizeof( uint32_t ), 0 );
+        } );
+
+    graph->add_pass( "dispatch",
+        { { input, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT }, { output, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT } },
+        { { output, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT } },
+        [this, slot]( const VkCommandBuffer cmd_buff ) {
+            vkn::GpuScope scope( cmd_buff, "dispatch", queue_family_index );
+
+            // The kernel only dereferences the pushed addresses, nothing to bind besides the pipeline
+            vkCmdBindPipeline( cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline );
+
+            const PushConstants push_constants {
+                .input_address = device_local_input_buffers[get_input_index( slot )]->device_address,
+                .output_address = device_local_output_buffers[slot]->device_address,
+                .num_elements = element_count,
+            };
+
+            vkCmdPushConstants( cmd_buff, vkn::get_push_constant_pipeline_layout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( push_constants ), &push_constants );
+
+            vkCmdDispatch( cmd_buff, get_group_count(), 1, 1 );
+        } );
+
+    // GPU -> CPU copy
+    graph->add_pass( "readback copy",
+        { { output, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT } },
+        { { host_output, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT } },
+        [this, src = device_local_output_buffer.buffer, dst = host_output_buffer.buffer]( const VkCommandBuffer cmd_buff ) {
+            vkn::GpuScope scope( cmd_buff, "readback copy", queue_family_index );
+
+            const VkBufferCopy buff_copy {
+                .srcOffset = 0,
+                .dstOffset = 0,
+                .size = sizeof( uint32_t )
+            };
+
+            vkCmdCopyBuffer( cmd_buff, src, dst, 1, &buff_copy );
+        } );
+
+    graph->compile();
+
+    return graph;
+}
+
+void ArraySum::upload_input( const uint32_t slot, const VkSemaphore signal_semaphore )
+{
+    // Source elements [first_element, first_element + element_count) land at the start of the input buffer
+    uint32_t block_element_count = 0;
+    for ( uint32_t uploaded = 0; uploaded < element_count; uploaded += block_element_count )
+    {
+        const uint32_t block_offset = ( first_element + uploaded ) % input_block_element_count;
+        block_element_count = std::min( input_block_element_count - block_offset, element_count - uploaded );
+        staging_buffer->queue_upload( device_local_input_buffers.at( get_input_index( slot ) )->buffer, static_cast<VkDeviceSize>( uploaded ) * sizeof( uint32_t ), block_element_count * sizeof( uint32_t ), host_input.data() + block_offset );
+    }
+
+    // No wait needed, the upload is ordered before the slot's dispatch by the flush's barrier (same queue) or by
+    // signal_semaphore plus the ownership acquire recorded in record() (other queue)
+    const std::vector<VkBufferMemoryBarrier> acquire_barriers = staging_buffer->flush( signal_semaphore, queue_family_index );
+    std::vector<VkBufferMemoryBarrier>& pending = pending_acquire_barriers[get_input_index( slot )];
+    pending.insert( pending.end(), acquire_barriers.begin(), acquire_barriers.end() );
+}
+
+void ArraySum::set_element_count( const uint32_t count )
+{
+    ASSERT( count > 0 && count <= element_capacity, "ArraySum element count %u out of range!\n", count );
+
+    element_count = count;
+
+    expected_result = HostArraySum::get_reference_sum( first_element + count ) - HostArraySum::get_reference_sum( first_element );
+}
+
+void ArraySum::set_first_element( const uint32_t first )
+{
+    first_element = first;
+
+    expected_result = HostArraySum::get_reference_sum( first_element + element_count ) - HostArraySum::get_reference_sum( first_element );
+}
+
+void ArraySum::set_specialization( const vkn::ComputeSpecialization& _specialization )
+{
+    pipeline = pipeline_variants->get( _specialization );
+    specialization = _specialization;
+}
+
+uint32_t ArraySum::get_group_count() const
+{
+    // Enough groups for every invocation to issue elements_per_thread loads; anything beyond the device limit
+    // is picked up by the shader's grid-stride loop instead of being dropped.
+    const uint32_t elements_per_load = specialization.vectorized ? 4 : 1;
+    const uint32_t elements_per_group = specialization.local_size_x * specialization.elements_per_thread * elements_per_load;
+    const uint32_t group_count = ( element_count + elements_per_group - 1 ) / elements_per_group;
+    const uint32_t max_group_count = vkn::get_physical_device_properties().limits.maxComputeWorkGroupCount[0];
+
+    return std::max( 1u, std::min( group_count, max_group_count ) );
+}
+
+void ArraySum::acquire_input( vkn::BarrierBatch& barrier_batch, const uint32_t slot )
+{
+    // Untouched once acquired, slots sharing the input may be recorded concurrently afterwards
+    std::vector<VkBufferMemoryBarrier>& pending = pending_acquire_barriers[get_input_index( slot )];
+    if ( pending.empty() )
+        return;
+
+    // acquire the input from the upload queue's family
+    for ( const VkBufferMemoryBarrier& acquire : pending )
+    {
+        vkn::acquire_buffer( barrier_batch, device_local_input_buffers[get_input_index( slot )]->sync_state, acquire.buffer, acquire.srcQueueFamilyIndex, acquire.dstQueueFamilyIndex,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT );
+    }
+
+    pending.clear();
+}
+
+void ArraySum::record_input_acquire( const VkCommandBuffer cmd_buff, const uint32_t slot )
+{
+    const Buffer& input_buffer = *device_local_input_buffers.at( get_input_index( slot ) );
+
+    vkn::BarrierBatch barrier_batch;
+    acquire_input( barrier_batch, slot );
+    // The dispatch's read, the slots' graphs find it already recorded
+    vkn::use_buffer( barrier_batch, input_buffer.sync_state, input_buffer.buffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT );
+    vkn::flush_barriers( cmd_buff, barrier_batch );
+}
+
+void ArraySum::record( const VkCommandBuffer cmd_buff, const uint32_t slot )
+{
+    vkn::BarrierBatch barrier_batch;
+    acquire_input( barrier_batch, slot );
+
+    // clear -> dispatch -> readback copy, the graph places the barriers between them. The acquires go out with
+    // the graph's entry barriers.
+    slot_graphs.at( slot )->execute( cmd_buff, barrier_batch );
+}
+
+uint32_t ArraySum::read_result( const uint32_t slot ) const
+{
+    uint32_t sum = 0;
+    memcpy( &sum, readback_ring->read( slot ), sizeof( uint32_t ) );
+
+    return sum;
+}
+
+void ArraySum::read_result_async( const uint32_t slot, const VkSemaphore timeline, const uint64_t value, const std::function<void( const uint32_t sum )>& callback )
+{
+    readback_ring->submit( slot, timeline, value, [callback]( const uint32_t, const void* const data ) {
+        uint32_t sum = 0;
+        memcpy( &sum, data, sizeof( uint32_t ) );
+        callback( sum );
+    } );
+}
+
+void ArraySum::poll_results()
+{
+    readback_ring->poll();
+}
@@ -0,0 +1,114 @@
+#ifndef ARRAY_SUM_HPP
+#define ARRAY_SUM_HPP
+
+#include "vkn.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+class Buffer;
+class ComputePipelineVariants;
+class FrameGraph;
+class ReadbackRing;
+class StagingBuffer;
+
+// Owns the array_sum kernel and its buffers. Every slot has its own output buffer and reads its input buffer
+// (possibly shared with neighbouring slots), the kernel reaches them through device addresses in push constants
+// (no descriptor sets). Slots can be uploaded, recorded and
+// submitted while other slots are still in flight. Uploads may run on a queue of another family (e.g.
+// transfer-only), ownership is then handed over to the compute family.
+class ArraySum
+{
+private:
+    // Matches array_sum.comp
+    struct PushConstants
+    {
+        VkDeviceAddress input_address { 0 };
+        VkDeviceAddress output_address { 0 };
+        uint32_t num_elements { 0 };
+    };
+
+    const uint32_t slot_count { 0 };
+    const uint32_t slots_per_input { 1 };
+    const uint32_t queue_family_index { 0 };
+    const uint32_t upload_queue_family_index { 0 };
+    const uint32_t element_capacity { 0 };
+
+    std::unique_ptr<ComputePipelineVariants> pipeline_variants { nullptr };
+    VkPipeline pipeline { VK_NULL_HANDLE };
+    vkn::ComputeSpecialization specialization {};
+
+    std::unique_ptr<StagingBuffer> staging_buffer { nullptr };
+
+    std::vector<std::unique_ptr<const Buffer>> device_local_input_buffers;     // one per slots_per_input slots
+    std::vector<std::unique_ptr<const Buffer>> device_local_output_buffers;
+    std::unique_ptr<ReadbackRing> readback_ring { nullptr };   // one slot per ArraySum slot
+
+    std::vector<uint32_t> host_input;
+    uint32_t element_count { 0 };
+    uint32_t first_element { 0 };
+    uint32_t expected_result { 0 };
+
+    std::vector<std::vector<VkBufferMemoryBarrier>> pending_acquire_barriers;   // per input buffer
+
+    // clear -> dispatch -> readback copy of every slot
+    std::vector<std::unique_ptr<FrameGraph>> slot_graphs;
+
+    void init_resources();
+    std::unique_ptr<FrameGraph> build_slot_graph( const uint32_t slot );
+    void acquire_input( vkn::BarrierBatch& barrier_batch, const uint32_t slot );
+
+    uint32_t get_input_index( const uint32_t slot ) const { return slot / slots_per_input; }
+
+    uint32_t get_group_count() const;
+public:
+    static constexpr uint32_t num_elements_to_sum = ( 10 << 20 );
+    static constexpr uint32_t input_block_element_count = ( 1 << 18 );
+    static constexpr const char* kernel_name = "array_sum.comp";
+
+    // Every input buffer holds element_capacity elements. Consecutive groups of slots_per_input slots read the
+    // same input buffer, every slot has its own output.
+    ArraySum( const uint32_t _slot_count, const uint32_t _queue_family_index, const VkQueue upload_queue, const uint32_t _upload_queue_family_index, const uint32_t _element_capacity = num_elements_to_sum, const uint32_t _slots_per_input = 1 );
+    ~ArraySum();
+
+    // Starts out with vkn::select_compute_specialization(), variants are kept so switching back is free
+    void set_specialization( const vkn::ComputeSpecialization& _specialization );
+    const vkn::ComputeSpecialization& get_specialization() const { return specialization; }
+
+    // Sums the first count elements (at most the capacity). Slots have to be uploaded again when it grows.
+    void set_element_count( const uint32_t count );
+    uint32_t get_element_count() const { return element_count; }
+    uint32_t get_element_capacity() const { return element_capacity; }
+
+    // Index of the source element that ends up first in the input buffers (0 by default), e.g. a shard's offset
+    // into the whole input. Slots have to be uploaded again after changing it.
+    void set_first_element( const uint32_t first );
+    uint32_t get_first_element() const { return first_element; }
+
+    // Streams the input into the slot's input buffer on the upload queue. When the upload queue is not the queue the
+    // slot is recorded for, the submission containing record() for the slot must wait on signal_semaphore.
+    void upload_input( const uint32_t slot, const VkSemaphore signal_semaphore = VK_NULL_HANDLE );
+
+    // Records (ownership acquire) -> clear -> dispatch -> readback copy for the given slot.
+    void record( const VkCommandBuffer cmd_buff, const uint32_t slot );
+
+    // Records the ownership acquire and the barrier before the dispatch's read of the slot's input. Slots sharing
+    // the input may then be recorded on several threads at once, their record() leaves the input's state alone.
+    void record_input_acquire( const VkCommandBuffer cmd_buff, const uint32_t slot );
+
+    // Only valid once the submission that recorded the slot has completed.
+    uint32_t read_result( const uint32_t slot ) const;
+
+    // Hands the slot's sum to callback from poll_results() once the submission signalling value on timeline
+    // (the one containing record() for the slot) has completed.
+    void read_result_async( const uint32_t slot, const VkSemaphore timeline, const uint64_t value, const std::function<void( const uint32_t sum )>& callback );
+    void poll_results();
+
+    // Host reference sum of the uploaded input, wraps modulo 2^32 like the kernel.
+    uint32_t get_expected_result() const { return expected_result; }
+};
+
+#endif // ARRAY_SUM_HPP
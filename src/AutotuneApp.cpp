@@ -0,0 +1,165 @@
+#include "AutotuneApp.hpp"
+#include "ArraySum.hpp"
+#include "vkn_profiler.hpp"
+#include "defines.hpp"
+
+#include "json_parser/json.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+struct ConfigInfoAutotune
+{
+    std::vector<uint32_t> element_counts;
+    std::vector<uint32_t> local_sizes;
+    std::vector<uint32_t> elements_per_thread;
+};
+
+void from_json(const nlohmann::json& j, ConfigInfoAutotune& c)
+{
+    j.at("element_counts").get_to(c.element_counts);
+    c.local_sizes = j.value("local_sizes", std::vector<uint32_t>{ 64, 128, 256, 512, 1024 });
+    c.elements_per_thread = j.value("elements_per_thread", std::vector<uint32_t>{ 1, 2, 4, 8, 16 });
+}
+
+static ConfigInfoAutotune read_autotune_config( const std::string_view config_file_path )
+{
+    std::ifstream file( config_file_path.data() );
+    ASSERT( file.is_open(), "Failed to open init config file: %s\n", config_file_path.data() );
+    return nlohmann::json::parse( file ).at( "autotune" ).get<ConfigInfoAutotune>();
+}
+
+AutotuneApp::AutotuneApp( const std::string_view config_file_path )
+    : HeadlessApp( config_file_path )
+{
+    const ConfigInfoAutotune config_info = read_autotune_config( config_file_path );
+    ASSERT( !config_info.element_counts.empty(), "Autotune config requires at least one element count!\n" );
+    // Autotuning switches variants and reads the dispatch time of every single iteration
+    ASSERT( HeadlessApp::get_iterations_per_submit() == 1 && !HeadlessApp::get_reuse_command_buffers(), "Autotuning requires one iteration per submit without command buffer reuse!\n" );
+
+    // Uploads and dispatches share queue 0, the staging flush orders the uploads before every later dispatch
+    const VkQueue queue = vkn::get_queue( 0 );
+    const uint32_t queue_family_index = vkn::get_queue_family_index( 0 );
+
+    array_sum = std::make_unique<ArraySum>( HeadlessApp::get_submissions_in_flight(), queue_family_index, queue, queue_family_index );
+    HeadlessApp::set_queue( 0 );
+
+    // Every smaller count sums a prefix of the largest upload
+    array_sum->set_element_count( *std::max_element( config_info.element_counts.begin(), config_info.element_counts.end() ) );
+    for ( uint32_t i = 0; i < HeadlessApp::get_submissions_in_flight(); i++ )
+        array_sum->upload_input( i );
+
+    std::vector<Candidate> candidates;
+    for ( const vkn::ComputeSpecialization& specialization : get_candidates( config_info.local_sizes, config_info.elements_per_thread ) )
+        candidates.push_back( { .specialization = specialization } );
+
+    ASSERT( !candidates.empty(), "No autotune candidate is supported by the device!\n" );
+
+    std::vector<double> best_ms( config_info.element_counts.size(), -1.0 );
+
+    for ( uint32_t i = 0; i < config_info.element_counts.size(); i++ )
+    {
+        array_sum->set_element_count( config_info.element_counts[i] );
+
+        for ( Candidate& candidate : candidates )
+        {
+            const double median_ms = measure( candidate.specialization );
+            candidate.median_ms.push_back( median_ms );
+
+            if ( median_ms >= 0.0 && ( best_ms[i] < 0.0 || median_ms < best_ms[i] ) )
+                best_ms[i] = median_ms;
+        }
+    }
+
+    // Lowest mean slowdown relative to the fastest candidate of every size, so small sizes count as much as large ones
+    const Candidate* winner = nullptr;
+    double winner_score = 0.0;
+
+    for ( const Candidate& candidate : candidates )
+    {
+        double score = 0.0;
+        bool valid = true;
+
+        for ( uint32_t i = 0; i < best_ms.size(); i++ )
+        {
+            valid = valid && candidate.median_ms[i] >= 0.0 && best_ms[i] > 0.0;
+            score += valid ? candidate.median_ms[i] / best_ms[i] : 0.0;
+        }
+
+        if ( valid && ( winner == nullptr || score < winner_score ) )
+        {
+            winner = &candidate;
+            winner_score = score;
+        }
+    }
+
+    ASSERT( winner != nullptr, "No autotune candidate produced a correct sum!\n" );
+
+    LOG( "Autotune winner for %s: local_size_x %u, elements_per_thread %u, unroll %u, vectorized %u (%.3fx the best per size)\n",
+        ArraySum::kernel_name, winner->specialization.local_size_x, winner->specialization.elements_per_thread, winner->specialization.unroll,
+        winner->specialization.vectorized, winner_score / static_cast<double>( best_ms.size() ) );
+
+    vkn::set_tuned_compute_specialization( ArraySum::kernel_name, winner->specialization );
+    vkn::save_tuned_compute_specializations();
+}
+
+AutotuneApp::~AutotuneApp()
+{
+}
+
+std::vector<vkn::ComputeSpecialization> AutotuneApp::get_candidates( const std::vector<uint32_t>& local_sizes, const std::vector<uint32_t>& elements_per_thread_counts ) const
+{
+    std::vector<vkn::ComputeSpecialization> candidates;
+
+    for ( const uint32_t local_size_x : local_sizes )
+    {
+        for ( const uint32_t elements_per_thread : elements_per_thread_counts )
+        {
+            for ( const VkBool32 vectorized : { VK_TRUE, VK_FALSE } )
+            {
+                const vkn::ComputeSpecialization specialization {
+                    .local_size_x = local_size_x,
+                    .elements_per_thread = elements_per_thread,
+                    .unroll = std::min( elements_per_thread, 4u ),
+                    .vectorized = vectorized,
+                };
+
+                if ( vkn::is_compute_specialization_supported( specialization ) )
+                    candidates.push_back( specialization );
+            }
+        }
+    }
+
+    return candidates;
+}
+
+double AutotuneApp::measure( const vkn::ComputeSpecialization& specialization )
+{
+    array_sum->set_specialization( specialization );
+    mismatch = false;
+
+    HeadlessApp::run();
+
+    if ( mismatch )
+        return -1.0;
+
+    for ( const vkn::GpuRegionStats& stats : vkn::profiler_get_stats() )
+    {
+        if ( stats.name == "dispatch" )
+            return stats.median_ms;
+    }
+
+    EXIT( "Autotuning requires GPU timestamps on the compute queue!\n" );
+    return -1.0;
+}
+
+void AutotuneApp::record_iteration( const VkCommandBuffer cmd_buff, const uint32_t slot, const uint32_t iteration )
+{
+    array_sum->record( cmd_buff, slot );
+}
+
+void AutotuneApp::complete_iteration( const uint32_t slot, const uint32_t iteration )
+{
+    if ( array_sum->read_result( slot ) != array_sum->get_expected_result() )
+        mismatch = true;
+}
@@ -0,0 +1,38 @@
+#ifndef AUTOTUNE_APP_HPP
+#define AUTOTUNE_APP_HPP
+
+#include "HeadlessApp.hpp"
+#include "vkn.hpp"
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <vector>
+
+class ArraySum;
+
+// Headless config with an "autotune" block. Sweeps the specializations of array_sum over several input sizes, times
+// every candidate with GPU timestamps and stores the fastest one per device in the device config's "tuning_path".
+class AutotuneApp : public HeadlessApp
+{
+private:
+    struct Candidate
+    {
+        vkn::ComputeSpecialization specialization {};
+        std::vector<double> median_ms;  // per element count, negative when the candidate produced a wrong sum
+    };
+
+    std::unique_ptr<ArraySum> array_sum { nullptr };
+    bool mismatch { false };
+
+    // Every supported combination, vectorised and scalar
+    std::vector<vkn::ComputeSpecialization> get_candidates( const std::vector<uint32_t>& local_sizes, const std::vector<uint32_t>& elements_per_thread_counts ) const;
+    double measure( const vkn::ComputeSpecialization& specialization );
+
+    virtual void record_iteration( const VkCommandBuffer cmd_buff, const uint32_t slot, const uint32_t iteration ) override final;
+    virtual void complete_iteration( const uint32_t slot, const uint32_t iteration ) override final;
+public:
+    AutotuneApp( const std::string_view config_file_path );
+    ~AutotuneApp();
+};
+
+#endif // AUTOTUNE_APP_HPP
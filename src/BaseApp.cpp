@@ -1,5 +1,10 @@
 #include "BaseApp.hpp"
 #include "vkn.hpp"
+#include "defines.hpp"
+
+#include "json_parser/json.hpp"
+
+#include <fstream>
 
 BaseApp::BaseApp( const std::string_view config_file_path )
 {
@@ -16,4 +21,29 @@ BaseApp::BaseApp( const std::string_view config_file_path )
 BaseApp::~BaseApp()
 {
     vkn::destroy();
-}
\ No newline at end of file
+}
+
+bool BaseApp::is_headless_config( const std::string_view config_file_path )
+{
+    return !has_config_block( config_file_path, "swapchain" );
+}
+
+bool BaseApp::has_config_block( const std::string_view config_file_path, const std::string_view block_name )
+{
+    std::ifstream file( config_file_path.data() );
+    ASSERT( file.is_open(), "Failed to open init config file: %s\n", config_file_path.data() );
+
+    const nlohmann::json json_data = nlohmann::json::parse( file );
+
+    return json_data.contains( std::string( block_name ) );
+}
+
+bool BaseApp::is_multi_device_config( const std::string_view config_file_path )
+{
+    std::ifstream file( config_file_path.data() );
+    ASSERT( file.is_open(), "Failed to open init config file: %s\n", config_file_path.data() );
+
+    const nlohmann::json json_data = nlohmann::json::parse( file );
+
+    return json_data.at( "device" ).value( "multi_device", false );
+}
@@ -14,6 +14,12 @@ protected:
 public:
     BaseApp( const std::string_view config_file_path );
     ~BaseApp();
+
+    // A config without a "swapchain" block describes a compute-only (headless) application.
+    static bool is_headless_config( const std::string_view config_file_path );
+    static bool has_config_block( const std::string_view config_file_path, const std::string_view block_name );
+    // "multi_device" in the device block creates a logical device per selected physical device.
+    static bool is_multi_device_config( const std::string_view config_file_path );
 };
 
-#endif // BASE_APP_HPP
\ No newline at end of file
+#endif // BASE_APP_HPP
@@ -0,0 +1,242 @@
+#include "BenchReduceApp.hpp"
+#include "ArraySum.hpp"
+#include "Buffer.hpp"
+#include "vkn.hpp"
+#include "vkn_profiler.hpp"
+#include "defines.hpp"
+
+#include "json_parser/json.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+struct ConfigInfoBench
+{
+    uint64_t min_bytes = 0;
+    uint64_t max_bytes = 0;
+    uint64_t copy_bytes = 0;
+    std::string output_path;
+};
+
+void from_json(const nlohmann::json& j, ConfigInfoBench& c)
+{
+    j.at("min_bytes").get_to(c.min_bytes);
+    j.at("max_bytes").get_to(c.max_bytes);
+    j.at("copy_bytes").get_to(c.copy_bytes);
+    j.at("output_path").get_to(c.output_path);
+}
+
+static ConfigInfoBench read_bench_config( const std::string_view config_file_path )
+{
+    std::ifstream file( config_file_path.data() );
+    ASSERT( file.is_open(), "Failed to open init config file: %s\n", config_file_path.data() );
+    return nlohmann::json::parse( file ).at( "bench" ).get<ConfigInfoBench>();
+}
+
+// Largest input the device can create and fit, input_count times plus the two copy buffers, into the device local
+// heap's budget. The kernel reads through a device address, so maxStorageBufferRange does not apply.
+static uint64_t get_max_input_bytes( const uint64_t requested_bytes, const uint32_t input_count )
+{
+    const VkPhysicalDeviceMemoryProperties& mem_props = vkn::get_physical_device_memory_properties();
+
+    VkDeviceSize device_local_heap_budget = 0;
+    for ( uint32_t i = 0; i < mem_props.memoryHeapCount; i++ )
+    {
+        if ( mem_props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT )
+            device_local_heap_budget = std::max( device_local_heap_budget, vkn::get_memory_heap_budget( i ) );
+    }
+
+    // ArraySum counts elements in 32 bits
+    const uint64_t max_element_bytes = static_cast<uint64_t>( UINT32_MAX ) * sizeof( uint32_t );
+
+    const uint64_t max_bytes = std::min( { requested_bytes, static_cast<uint64_t>( vkn::get_physical_device_maintenance4_properties().maxBufferSize ),
+        device_local_heap_budget / ( input_count + 2 ), max_element_bytes } );
+    return max_bytes & ~uint64_t( 3 );
+}
+
+static std::vector<double> get_percentiles( std::vector<double> samples )
+{
+    std::sort( samples.begin(), samples.end() );
+    return { vkn::get_percentile( samples, 0.5 ), vkn::get_percentile( samples, 0.9 ), vkn::get_percentile( samples, 0.99 ) };
+}
+
+// Per iteration, the profiler sums the scopes of every iteration in a submission
+static std::vector<double> get_region_percentiles( const char* const region_name, const uint32_t iterations_per_submit )
+{
+    for ( const vkn::GpuRegionStats& stats : vkn::profiler_get_stats() )
+    {
+        if ( stats.name == region_name )
+            return { stats.median_ms / iterations_per_submit, stats.p90_ms / iterations_per_submit, stats.p99_ms / iterations_per_submit };
+    }
+
+    EXIT( "bench_reduce requires GPU timestamps on the compute queue!\n" );
+    return {};
+}
+
+BenchReduceApp::BenchReduceApp( const std::string_view config_file_path )
+    : HeadlessApp( config_file_path )
+{
+    const ConfigInfoBench config_info = read_bench_config( config_file_path );
+    // Wall times start when a submission is recorded
+    ASSERT( !HeadlessApp::get_reuse_command_buffers(), "bench_reduce does not support command buffer reuse!\n" );
+    // Iterations share the copy buffers and their sync state
+    ASSERT( HeadlessApp::get_recording_threads() == 0, "bench_reduce does not support recording threads!\n" );
+
+    const uint64_t max_bytes = get_max_input_bytes( config_info.max_bytes, HeadlessApp::get_submissions_in_flight() );
+    ASSERT( config_info.min_bytes >= sizeof( uint32_t ) && config_info.min_bytes <= max_bytes, "Bench sizes [%lu, %lu] do not fit the device (max %lu bytes)!\n",
+        config_info.min_bytes, config_info.max_bytes, max_bytes );
+
+    if ( max_bytes < config_info.max_bytes )
+    {
+        LOG( "Limiting bench input to %lu bytes (device limits)\n", max_bytes );
+    }
+
+    // Uploads and dispatches share queue 0, the staging flush orders the uploads before every later dispatch
+    const VkQueue queue = vkn::get_queue( 0 );
+    const uint32_t queue_family_index = vkn::get_queue_family_index( 0 );
+
+    array_sum = std::make_unique<ArraySum>( HeadlessApp::get_submissions_in_flight(), queue_family_index, queue, queue_family_index, static_cast<uint32_t>( max_bytes / sizeof( uint32_t ) ) );
+    HeadlessApp::set_queue( 0 );
+    record_times.resize( HeadlessApp::get_submissions_in_flight() );
+
+    const VkDeviceSize copy_bytes = std::min( config_info.copy_bytes, max_bytes );
+    copy_src_buffer = std::make_unique<const Buffer>( VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, copy_bytes );
+    copy_dst_buffer = std::make_unique<const Buffer>( VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, copy_bytes );
+
+    const double copy_gb_per_s = measure_copy_bandwidth();
+    LOG( "Device copy bandwidth: %.2f GB/s\n", copy_gb_per_s );
+
+    // Every smaller size sums a prefix of the largest upload
+    for ( uint32_t i = 0; i < HeadlessApp::get_submissions_in_flight(); i++ )
+        array_sum->upload_input( i );
+
+    std::vector<SizeResult> results;
+    for ( uint64_t bytes = config_info.min_bytes; bytes <= max_bytes; bytes *= 2 )
+    {
+        const SizeResult result = measure_reduce( static_cast<uint32_t>( bytes / sizeof( uint32_t ) ) );
+        results.push_back( result );
+
+        LOG( "%12lu bytes: GPU median %9.4f ms, p90 %9.4f ms, p99 %9.4f ms | wall median %9.4f ms, p90 %9.4f ms, p99 %9.4f ms | %8.2f GB/s (%5.1f%% of copy)%s\n",
+            result.bytes, result.gpu_ms[0], result.gpu_ms[1], result.gpu_ms[2], result.wall_ms[0], result.wall_ms[1], result.wall_ms[2],
+            result.gb_per_s, copy_gb_per_s > 0.0 ? 100.0 * result.gb_per_s / copy_gb_per_s : 0.0, result.correct ? "" : " (MISMATCH)" );
+    }
+
+    write_results( config_info.output_path, copy_gb_per_s, results );
+}
+
+BenchReduceApp::~BenchReduceApp()
+{
+}
+
+double BenchReduceApp::measure_copy_bandwidth()
+{
+    mode = Mode::COPY;
+    wall_times_ms.clear();
+
+    HeadlessApp::run();
+
+    // A copy reads and writes every byte
+    const double median_ms = get_region_percentiles( "copy", HeadlessApp::get_iterations_per_submit() )[0];
+    return median_ms > 0.0 ? ( 2.0 * static_cast<double>( copy_src_buffer->size ) ) / ( median_ms * 1e6 ) : 0.0;
+}
+
+BenchReduceApp::SizeResult BenchReduceApp::measure_reduce( const uint32_t element_count )
+{
+    mode = Mode::REDUCE;
+    mismatch = false;
+    wall_times_ms.clear();
+
+    array_sum->set_element_count( element_count );
+    HeadlessApp::run();
+
+    SizeResult result {
+        .bytes = static_cast<uint64_t>( element_count ) * sizeof( uint32_t ),
+        .gpu_ms = get_region_percentiles( "dispatch", HeadlessApp::get_iterations_per_submit() ),
+        .wall_ms = get_percentiles( wall_times_ms ),
+        .gb_per_s = 0.0,
+        .correct = !mismatch,
+    };
+
+    // The reduction reads every byte once
+    if ( result.gpu_ms[0] > 0.0 )
+        result.gb_per_s = static_cast<double>( result.bytes ) / ( result.gpu_ms[0] * 1e6 );
+
+    return result;
+}
+
+void BenchReduceApp::write_results( const std::string& output_path, const double copy_gb_per_s, const std::vector<SizeResult>& results ) const
+{
+    const VkPhysicalDeviceProperties& props = vkn::get_physical_device_properties();
+
+    nlohmann::json json_results = nlohmann::json::array();
+    for ( const SizeResult& result : results )
+    {
+        json_results.push_back( {
+            { "bytes", result.bytes },
+            { "gpu_ms", { { "median", result.gpu_ms[0] }, { "p90", result.gpu_ms[1] }, { "p99", result.gpu_ms[2] } } },
+            { "wall_ms", { { "median", result.wall_ms[0] }, { "p90", result.wall_ms[1] }, { "p99", result.wall_ms[2] } } },
+            { "gb_per_s", result.gb_per_s },
+            { "roofline_ratio", copy_gb_per_s > 0.0 ? result.gb_per_s / copy_gb_per_s : 0.0 },
+            { "correct", result.correct },
+        } );
+    }
+
+    const vkn::ComputeSpecialization& specialization = array_sum->get_specialization();
+
+    const nlohmann::json json_data = {
+        { "device_name", props.deviceName },
+        { "driver_version", props.driverVersion },
+        { "specialization", {
+            { "local_size_x", specialization.local_size_x },
+            { "elements_per_thread", specialization.elements_per_thread },
+            { "unroll", specialization.unroll },
+            { "vectorized", specialization.vectorized == VK_TRUE } } },
+        { "copy_gb_per_s", copy_gb_per_s },
+        { "results", json_results },
+    };
+
+    std::ofstream file( output_path );
+    ASSERT( file.is_open(), "Failed to open bench output file: %s\n", output_path.c_str() );
+    file << json_data.dump( 4 ) << '\n';
+
+    LOG( "Wrote %s\n", output_path.c_str() );
+}
+
+void BenchReduceApp::record_iteration( const VkCommandBuffer cmd_buff, const uint32_t slot, const uint32_t iteration )
+{
+    // Wall time starts when the submission's first iteration is recorded
+    if ( iteration % HeadlessApp::get_iterations_per_submit() == 0 )
+        record_times[slot] = std::chrono::steady_clock::now();
+
+    if ( mode == Mode::COPY )
+    {
+        // Back to back copies within a submission overwrite the same destination
+        vkn::BarrierBatch barrier_batch;
+        vkn::use_buffer( barrier_batch, copy_src_buffer->sync_state, copy_src_buffer->buffer, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT );
+        vkn::use_buffer( barrier_batch, copy_dst_buffer->sync_state, copy_dst_buffer->buffer, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT );
+        vkn::flush_barriers( cmd_buff, barrier_batch );
+
+        vkn::GpuScope scope( cmd_buff, "copy" );
+
+        const VkBufferCopy buff_copy {
+            .srcOffset = 0,
+            .dstOffset = 0,
+            .size = copy_src_buffer->size,
+        };
+
+        vkCmdCopyBuffer( cmd_buff, copy_src_buffer->buffer, copy_dst_buffer->buffer, 1, &buff_copy );
+    }
+    else
+    {
+        array_sum->record( cmd_buff, slot );
+    }
+}
+
+void BenchReduceApp::complete_iteration( const uint32_t slot, const uint32_t iteration )
+{
+    // Per iteration of the submission
+    wall_times_ms.push_back( std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - record_times[slot] ).count() / HeadlessApp::get_iterations_per_submit() );
+
+    if ( mode == Mode::REDUCE && array_sum->read_result( slot ) != array_sum->get_expected_result() )
+        mismatch = true;
+}
@@ -0,0 +1,55 @@
+#ifndef BENCH_REDUCE_APP_HPP
+#define BENCH_REDUCE_APP_HPP
+
+#include "HeadlessApp.hpp"
+
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ArraySum;
+struct Buffer;
+
+// Headless config with a "bench" block. Sums inputs of doubling sizes, times every iteration on the GPU (timestamps)
+// and on the host (record to retire), and compares the achieved read bandwidth with a measured device copy.
+class BenchReduceApp : public HeadlessApp
+{
+private:
+    enum class Mode
+    {
+        COPY,
+        REDUCE,
+    };
+
+    struct SizeResult
+    {
+        uint64_t bytes { 0 };
+        std::vector<double> gpu_ms;    // median, p90, p99
+        std::vector<double> wall_ms;   // median, p90, p99
+        double gb_per_s { 0.0 };
+        bool correct { true };
+    };
+
+    std::unique_ptr<ArraySum> array_sum { nullptr };
+    std::unique_ptr<const Buffer> copy_src_buffer { nullptr };
+    std::unique_ptr<const Buffer> copy_dst_buffer { nullptr };
+
+    Mode mode { Mode::REDUCE };
+    bool mismatch { false };
+    std::vector<std::chrono::steady_clock::time_point> record_times;   // per slot
+    std::vector<double> wall_times_ms;
+
+    double measure_copy_bandwidth();
+    SizeResult measure_reduce( const uint32_t element_count );
+    void write_results( const std::string& output_path, const double copy_gb_per_s, const std::vector<SizeResult>& results ) const;
+
+    virtual void record_iteration( const VkCommandBuffer cmd_buff, const uint32_t slot, const uint32_t iteration ) override final;
+    virtual void complete_iteration( const uint32_t slot, const uint32_t iteration ) override final;
+public:
+    BenchReduceApp( const std::string_view config_file_path );
+    ~BenchReduceApp();
+};
+
+#endif // BENCH_REDUCE_APP_HPP
@@ -4,19 +4,29 @@
 Buffer::Buffer( const VkBufferUsageFlags usage_flags, const VkMemoryPropertyFlags memory_flags, const VkDeviceSize _size )
     : size { _size }
     , buffer { vkn::create_buffer( usage_flags, size ) }
-    , memory { vkn::alloc_buffer_memory( buffer, memory_flags ) }
+    , allocation { vkn::allocate_buffer_memory( buffer, memory_flags ) }
+    , memory { allocation.memory }
+    , memory_offset { allocation.offset }
     , own_memory { true }
 {
-    vkn::bind_buffer_memory( buffer, memory, 0 );
+    vkn::bind_buffer_memory( buffer, memory, memory_offset );
+
+    if ( usage_flags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT )
+        device_address = vkn::get_device_address( buffer );
 }
 
 Buffer::Buffer( const VkBufferUsageFlags usage_flags, const VkDeviceMemory _memory, const VkDeviceSize offset, const VkDeviceSize _size )
     : size { _size }
     , buffer { vkn::create_buffer( usage_flags, size ) }
+    , allocation {}
     , memory { _memory }
+    , memory_offset { offset }
     , own_memory { false }
 {
-    vkn::bind_buffer_memory( buffer, memory, offset );
+    vkn::bind_buffer_memory( buffer, memory, memory_offset );
+
+    if ( usage_flags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT )
+        device_address = vkn::get_device_address( buffer );
 }
 
 Buffer::~Buffer()
@@ -25,6 +35,6 @@ Buffer::~Buffer()
 
     if ( own_memory )
     {
-        vkn::free_memory( memory );
+        vkn::free_allocation( allocation );
     }
-}
\ No newline at end of file
+}
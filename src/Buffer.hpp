@@ -1,18 +1,32 @@
 #ifndef BUFFER_HPP
 #define BUFFER_HPP
 
+#include "vkn.hpp"
+
 #include <vulkan/vulkan.h>
 
 struct Buffer
 {
     const VkDeviceSize size { 0 };
     const VkBuffer buffer { VK_NULL_HANDLE };
+    const vkn::Allocation allocation {};
     const VkDeviceMemory memory { VK_NULL_HANDLE };
+    const VkDeviceSize memory_offset { 0 };
     const bool own_memory { false };
 
+    // Recording state for vkn::use_buffer(), mutable so const buffers can be tracked
+    mutable vkn::BufferSyncState sync_state {};
+
+    // Buffers created with SHADER_DEVICE_ADDRESS usage only, sub-ranges are plain offsets from it
+    VkDeviceAddress device_address { 0 };
+
+    // Sub-allocated from the vkn allocator. Host visible buffers are persistently mapped.
     Buffer( const VkBufferUsageFlags usage_flags, const VkMemoryPropertyFlags memory_flags, const VkDeviceSize _size );
+    // Placed in caller owned memory.
     Buffer( const VkBufferUsageFlags usage_flags, const VkDeviceMemory _memory, const VkDeviceSize offset, const VkDeviceSize _size );
     ~Buffer();
+
+    void* get_mapped_ptr() const { return allocation.mapped_ptr; }
 };
 
-#endif // BUFFER_HPP
\ No newline at end of file
+#endif // BUFFER_HPP
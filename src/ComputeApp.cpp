@@ -0,0 +1,104 @@
+#include "ComputeApp.hpp"
+#include "vkn.hpp"
+#include "ArraySum.hpp"
+#include "HostArraySum.hpp"
+#include "defines.hpp"
+
+ComputeApp::ComputeApp( const std::string_view config_file_path )
+    : HeadlessApp( config_file_path )
+{
+    // Queues of queue 0's family dispatch. A second configured queue (ideally on a transfer-only family) streams the
+    // inputs, so uploads for the next iterations overlap the dispatches already in flight. Reused command buffers
+    // upload once up front on queue 0 instead, an ownership acquire cannot be replayed.
+    const bool reuse = HeadlessApp::get_reuse_command_buffers();
+    const uint32_t upload_queue_index = ( vkn::get_queue_count() > 1 && !reuse ) ? 1 : 0;
+
+    const uint32_t element_count = ( HeadlessApp::get_element_count() > 0 ) ? HeadlessApp::get_element_count() : ArraySum::num_elements_to_sum;
+
+    const uint32_t slots_per_submission = ( HeadlessApp::get_recording_threads() > 0 ) ? HeadlessApp::get_iterations_per_submit() : 1;
+    array_sum = std::make_unique<ArraySum>( HeadlessApp::get_submissions_in_flight() * slots_per_submission, vkn::get_queue_family_index( 0 ), vkn::get_queue( upload_queue_index ), vkn::get_queue_family_index( upload_queue_index ), element_count, slots_per_submission );
+
+    // The CPU backend sums the same input, every GPU result is checked against it
+    {
+        HostArraySum host_array_sum( 1, element_count );
+        host_array_sum.upload_input( 0 );
+        host_array_sum.run( 0 );
+
+        host_reference = host_array_sum.read_result( 0 );
+        ASSERT( host_reference == host_array_sum.get_expected_result(), "Host reference sum %u does not match the closed form %u!\n", host_reference, host_array_sum.get_expected_result() );
+    }
+
+    if ( upload_queue_index != 0 )
+    {
+        for ( uint32_t i = 0; i < HeadlessApp::get_submissions_in_flight(); i++ )
+            upload_semaphores.push_back( vkn::create_semaphore() );
+    }
+
+    if ( reuse )
+    {
+        // The input never changes, the staging flush orders the uploads before every later dispatch on queue 0
+        for ( uint32_t i = 0; i < HeadlessApp::get_submissions_in_flight(); i++ )
+            array_sum->upload_input( get_array_sum_slot( i, 0 ) );
+
+        HeadlessApp::set_queue( 0 );
+    }
+    else
+    {
+        // Uploads on another queue are waited on through their semaphore, so dispatches may use any queue of the family
+        HeadlessApp::set_queue_family( vkn::get_queue_family_index( 0 ) );
+    }
+
+    HeadlessApp::run();
+
+    vkn::log_memory_stats();
+}
+
+ComputeApp::~ComputeApp()
+{
+    for ( const VkSemaphore semaphore : upload_semaphores )
+        vkn::destroy_semaphore( semaphore );
+}
+
+uint32_t ComputeApp::get_array_sum_slot( const uint32_t slot, const uint32_t iteration ) const
+{
+    if ( HeadlessApp::get_recording_threads() == 0 )
+        return slot;
+
+    const uint32_t iterations_per_submit = HeadlessApp::get_iterations_per_submit();
+    return slot * iterations_per_submit + iteration % iterations_per_submit;
+}
+
+void ComputeApp::prepare_submission( const VkCommandBuffer cmd_buff, const uint32_t slot, const uint32_t first_iteration )
+{
+    // Inputs are streamed once per submission, reused command buffers were uploaded up front
+    if ( HeadlessApp::get_reuse_command_buffers() )
+        return;
+
+    // The slot's previous dispatches have retired, so its input buffer and semaphore are free to reuse
+    const VkSemaphore upload_semaphore = upload_semaphores.empty() ? VK_NULL_HANDLE : upload_semaphores[slot];
+    const uint32_t array_sum_slot = get_array_sum_slot( slot, first_iteration );
+    array_sum->upload_input( array_sum_slot, upload_semaphore );
+
+    if ( upload_semaphore != VK_NULL_HANDLE )
+        HeadlessApp::add_wait_semaphore( upload_semaphore, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT );
+
+    // Every iteration reads the input, the acquire goes into the primary ahead of all of them
+    array_sum->record_input_acquire( cmd_buff, array_sum_slot );
+}
+
+void ComputeApp::record_iteration( const VkCommandBuffer cmd_buff, const uint32_t slot, const uint32_t iteration )
+{
+    array_sum->record( cmd_buff, get_array_sum_slot( slot, iteration ) );
+}
+
+void ComputeApp::complete_iteration( const uint32_t slot, const uint32_t iteration )
+{
+    // Iterations recorded in parallel left a sum each, the others overwrote the slot's
+    const uint32_t first_iteration = ( HeadlessApp::get_recording_threads() > 0 ) ? iteration + 1 - HeadlessApp::get_iterations_per_submit() : iteration;
+
+    for ( uint32_t i = first_iteration; i <= iteration; i++ )
+    {
+        const uint32_t sum = array_sum->read_result( get_array_sum_slot( slot, i ) );
+        LOG("Iteration %u Sum: %u%s\n", i, sum, ( sum == host_reference ) ? "" : " (MISMATCH)");
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef COMPUTE_APP_HPP
+#define COMPUTE_APP_HPP
+
+#include "HeadlessApp.hpp"
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <vector>
+
+class ArraySum;
+
+class ComputeApp : public HeadlessApp
+{
+private:
+    std::unique_ptr<ArraySum> array_sum { nullptr };
+    uint32_t host_reference { 0 };
+
+    // Signalled by the slot's upload on the transfer queue, waited on by the slot's dispatch.
+    // Empty when uploads share the compute queue.
+    std::vector<VkSemaphore> upload_semaphores;
+
+    // Iterations recorded in parallel each use their own ArraySum slot (output and readback) reading the
+    // submission's one input, otherwise a submission's iterations share one slot
+    uint32_t get_array_sum_slot( const uint32_t slot, const uint32_t iteration ) const;
+
+    virtual void prepare_submission( const VkCommandBuffer cmd_buff, const uint32_t slot, const uint32_t first_iteration ) override final;
+    virtual void record_iteration( const VkCommandBuffer cmd_buff, const uint32_t slot, const uint32_t iteration ) override final;
+    virtual void complete_iteration( const uint32_t slot, const uint32_t iteration ) override final;
+public:
+    ComputeApp( const std::string_view config_file_path );
+    ~ComputeApp();
+};
+
+#endif // COMPUTE_APP_HPP
@@ -0,0 +1,31 @@
+#include "ComputePipelineVariants.hpp"
+#include "defines.hpp"
+
+ComputePipelineVariants::ComputePipelineVariants( const std::string_view shader_name, const VkPipelineLayout _layout )
+    : module { vkn::acquire_shader_module( shader_name ) }
+    , layout { _layout }
+{
+}
+
+ComputePipelineVariants::~ComputePipelineVariants()
+{
+    for ( const auto& [specialization, pipeline] : variants )
+        vkn::destroy_pipeline( pipeline );
+
+    vkn::release_shader_module( module );
+}
+
+VkPipeline ComputePipelineVariants::get( const vkn::ComputeSpecialization& specialization )
+{
+    for ( const auto& [variant_specialization, pipeline] : variants )
+    {
+        if ( variant_specialization == specialization )
+            return pipeline;
+    }
+
+    const VkPipeline pipeline = vkn::create_compute_pipeline( module, layout, specialization );
+    variants.emplace_back( specialization, pipeline );
+
+    LOG( "Created pipeline variant local_size_x %u, elements_per_thread %u, unroll %u, vectorized %u\n", specialization.local_size_x, specialization.elements_per_thread, specialization.unroll, specialization.vectorized );
+    return pipeline;
+}
@@ -0,0 +1,30 @@
+#ifndef COMPUTE_PIPELINE_VARIANTS_HPP
+#define COMPUTE_PIPELINE_VARIANTS_HPP
+
+#include "vkn.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Pipelines of one compute kernel, one per specialization it has been requested with. Variants are created on
+// first use through the shared pipeline cache and live as long as this object. Kernels only have a handful of
+// variants, so they are kept in a flat list.
+class ComputePipelineVariants
+{
+private:
+    const VkShaderModule module { VK_NULL_HANDLE };
+    const VkPipelineLayout layout { VK_NULL_HANDLE };
+
+    std::vector<std::pair<vkn::ComputeSpecialization, VkPipeline>> variants;
+public:
+    // Takes a reference on the module, the layout has to outlive this object
+    ComputePipelineVariants( const std::string_view shader_name, const VkPipelineLayout _layout );
+    ~ComputePipelineVariants();
+
+    VkPipeline get( const vkn::ComputeSpecialization& specialization );
+};
+
+#endif // COMPUTE_PIPELINE_VARIANTS_HPP
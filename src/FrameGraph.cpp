@@ -0,0 +1,574 @@
+#include "FrameGraph.hpp"
+#include "Buffer.hpp"
+#include "vkn.hpp"
+#include "defines.hpp"
+
+#include <algorithm>
+
+namespace
+{
+
+struct ResourceState
+{
+    VkPipelineStageFlags2 write_stage { VK_PIPELINE_STAGE_2_NONE };     // last write
+    VkAccessFlags2 write_access { VK_ACCESS_2_NONE };
+    VkPipelineStageFlags2 read_stage { VK_PIPELINE_STAGE_2_NONE };      // reads since the last write
+    VkPipelineStageFlags2 visible_stage { VK_PIPELINE_STAGE_2_NONE };   // the last write is available to these
+    VkAccessFlags2 visible_access { VK_ACCESS_2_NONE };
+
+    // Every access so far, waited for before aliased memory is reused
+    VkPipelineStageFlags2 all_stages { VK_PIPELINE_STAGE_2_NONE };
+    VkAccessFlags2 all_write_access { VK_ACCESS_2_NONE };
+};
+
+struct BarrierMasks
+{
+    VkPipelineStageFlags2 src_stage { VK_PIPELINE_STAGE_2_NONE };
+    VkAccessFlags2 src_access { VK_ACCESS_2_NONE };
+    VkPipelineStageFlags2 dst_stage { VK_PIPELINE_STAGE_2_NONE };
+    VkAccessFlags2 dst_access { VK_ACCESS_2_NONE };
+};
+
+static VkBufferMemoryBarrier2 make_buffer_barrier( const VkBuffer buffer, const BarrierMasks& masks )
+{
+    const VkBufferMemoryBarrier2 barrier {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .pNext = nullptr,
+        .srcStageMask = masks.src_stage,
+        .srcAccessMask = masks.src_access,
+        .dstStageMask = masks.dst_stage,
+        .dstAccessMask = masks.dst_access,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+
+    return barrier;
+}
+
+static void emit_barriers( const VkCommandBuffer cmd_buff, const VkMemoryBarrier2* const memory_barrier, const std::vector<VkBufferMemoryBarrier2>& buffer_barriers )
+{
+    if ( memory_barrier == nullptr && buffer_barriers.empty() )
+        return;
+
+    const VkDependencyInfo dependency_info {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = 0x0,
+        .memoryBarrierCount = ( memory_barrier != nullptr ) ? 1u : 0u,
+        .pMemoryBarriers = memory_barrier,
+        .bufferMemoryBarrierCount = static_cast<uint32_t>( buffer_barriers.size() ),
+        .pBufferMemoryBarriers = buffer_barriers.data(),
+        .imageMemoryBarrierCount = 0,
+        .pImageMemoryBarriers = nullptr,
+    };
+
+    vkCmdPipelineBarrier2( cmd_buff, &dependency_info );
+}
+
+static VkDeviceSize align_up( const VkDeviceSize value, const VkDeviceSize alignment )
+{
+    return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+}
+
+FrameGraph::~FrameGraph()
+{
+    transient_buffers.clear();
+
+    if ( transient_allocation.memory != VK_NULL_HANDLE )
+        vkn::free_allocation( transient_allocation );
+}
+
+FrameGraph::ResourceId FrameGraph::import_buffer( const char* const name, const Buffer& buffer, const bool keep, const VkPipelineStageFlags2 final_stage, const VkAccessFlags2 final_access )
+{
+    ASSERT( !compiled, "Frame graph resources have to be added before compile()!\n" );
+
+    resources.push_back( {
+        .name = name,
+        .buffer = buffer.buffer,
+        .size = buffer.size,
+        .usage = 0x0,
+        .transient = false,
+        .keep = keep,
+        .final_stage = final_stage,
+        .final_access = final_access,
+        .sync_state = &buffer.sync_state,
+    } );
+
+    return static_cast<ResourceId>( resources.size() - 1 );
+}
+
+FrameGraph::ResourceId FrameGraph::create_transient_buffer( const char* const name, const VkBufferUsageFlags usage, const VkDeviceSize size )
+{
+    ASSERT( !compiled, "Frame graph resources have to be added before compile()!\n" );
+
+    resources.push_back( {
+        .name = name,
+        .buffer = VK_NULL_HANDLE,
+        .size = size,
+        .usage = usage,
+        .transient = true,
+        .keep = false,
+    } );
+
+    return static_cast<ResourceId>( resources.size() - 1 );
+}
+
+void FrameGraph::add_pass( const char* const name, const std::vector<BufferAccess>& reads, const std::vector<BufferAccess>& writes, const RecordFunction& record, const bool side_effect )
+{
+    ASSERT( !compiled, "Frame graph passes have to be added before compile()!\n" );
+
+    for ( const BufferAccess& access : reads )
+        ASSERT( access.buffer < resources.size(), "Pass %s reads an unknown buffer!\n", name );
+    for ( const BufferAccess& access : writes )
+        ASSERT( access.buffer < resources.size(), "Pass %s writes an unknown buffer!\n", name );
+
+    passes.push_back( {
+        .name = name,
+        .reads = reads,
+        .writes = writes,
+        .record = record,
+        .side_effect = side_effect,
+    } );
+}
+
+std::vector<bool> FrameGraph::cull_passes() const
+{
+    std::vector<bool> live( passes.size(), false );
+
+    for ( uint32_t i = 0; i < passes.size(); i++ )
+    {
+        live[i] = passes[i].side_effect;
+        for ( const BufferAccess& access : passes[i].writes )
+            live[i] = live[i] || resources[access.buffer].keep;
+    }
+
+    // Walking backwards, a live pass keeps the last earlier writer of everything it reads
+    for ( uint32_t j = static_cast<uint32_t>( passes.size() ); j-- > 0; )
+    {
+        if ( !live[j] )
+            continue;
+
+        for ( const BufferAccess& read : passes[j].reads )
+        {
+            for ( uint32_t i = j; i-- > 0; )
+            {
+                const bool writes_it = std::any_of( passes[i].writes.begin(), passes[i].writes.end(), [&]( const BufferAccess& write ) { return write.buffer == read.buffer; } );
+                if ( writes_it )
+                {
+                    live[i] = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    return live;
+}
+
+std::vector<uint32_t> FrameGraph::assign_levels( const std::vector<bool>& live ) const
+{
+    std::vector<uint32_t> pass_levels( passes.size(), UINT32_MAX );
+
+    const auto touches = []( const std::vector<BufferAccess>& accesses, const ResourceId buffer ) {
+        return std::any_of( accesses.begin(), accesses.end(), [&]( const BufferAccess& access ) { return access.buffer == buffer; } );
+    };
+
+    // Two passes conflict when one of them writes a buffer the other one uses, the later one goes to a later level
+    for ( uint32_t j = 0; j < passes.size(); j++ )
+    {
+        if ( !live[j] )
+            continue;
+
+        uint32_t level = 0;
+        for ( uint32_t i = 0; i < j; i++ )
+        {
+            if ( !live[i] )
+                continue;
+
+            bool conflict = false;
+            for ( const BufferAccess& write : passes[i].writes )
+                conflict = conflict || touches( passes[j].reads, write.buffer ) || touches( passes[j].writes, write.buffer );
+            for ( const BufferAccess& read : passes[i].reads )
+                conflict = conflict || touches( passes[j].writes, read.buffer );
+
+            if ( conflict )
+                level = std::max( level, pass_levels[i] + 1 );
+        }
+
+        pass_levels[j] = level;
+    }
+
+    return pass_levels;
+}
+
+void FrameGraph::place_transients( const std::vector<uint32_t>& first_level, const std::vector<uint32_t>& last_level, std::vector<VkDeviceSize>& offsets, std::vector<VkDeviceSize>& sizes )
+{
+    offsets.assign( resources.size(), 0 );
+    sizes.assign( resources.size(), 0 );
+
+    std::vector<VkDeviceSize> alignments( resources.size(), 1 );
+    std::vector<uint32_t> placement_order;
+
+    VkMemoryRequirements merged_reqs {
+        .size = 0,
+        .alignment = 1,
+        .memoryTypeBits = UINT32_MAX,
+    };
+
+    for ( uint32_t i = 0; i < resources.size(); i++ )
+    {
+        if ( !resources[i].transient || first_level[i] == UINT32_MAX )
+            continue;
+
+        // Placed buffers are created with the same usage and size, so they have the same requirements
+        const VkBuffer probe_buffer = vkn::create_buffer( resources[i].usage, resources[i].size );
+        const VkMemoryRequirements mem_reqs = vkn::get_buffer_memory_requirements( probe_buffer );
+        vkn::destroy_buffer( probe_buffer );
+
+        sizes[i] = mem_reqs.size;
+        alignments[i] = mem_reqs.alignment;
+        merged_reqs.alignment = std::max( merged_reqs.alignment, mem_reqs.alignment );
+        merged_reqs.memoryTypeBits &= mem_reqs.memoryTypeBits;
+
+        placement_order.push_back( i );
+    }
+
+    if ( placement_order.empty() )
+        return;
+
+    ASSERT( merged_reqs.memoryTypeBits != 0, "Frame graph transient buffers have no memory type in common!\n" );
+
+    // Largest first, every buffer goes to the lowest offset clear of the placed buffers it is alive with
+    std::stable_sort( placement_order.begin(), placement_order.end(), [&]( const uint32_t a, const uint32_t b ) { return sizes[a] > sizes[b]; } );
+
+    std::vector<uint32_t> placed;
+    for ( const uint32_t i : placement_order )
+    {
+        std::vector<uint32_t> overlapping;
+        for ( const uint32_t j : placed )
+        {
+            if ( first_level[i] <= last_level[j] && first_level[j] <= last_level[i] )
+                overlapping.push_back( j );
+        }
+
+        std::sort( overlapping.begin(), overlapping.end(), [&]( const uint32_t a, const uint32_t b ) { return offsets[a] < offsets[b]; } );
+
+        VkDeviceSize offset = 0;
+        for ( const uint32_t j : overlapping )
+        {
+            if ( align_up( offset, alignments[i] ) + sizes[i] <= offsets[j] )
+                break;
+
+            offset = std::max( offset, offsets[j] + sizes[j] );
+        }
+
+        offsets[i] = align_up( offset, alignments[i] );
+        merged_reqs.size = std::max( merged_reqs.size, offsets[i] + sizes[i] );
+        placed.push_back( i );
+    }
+
+    transient_allocation = vkn::allocate_memory( merged_reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+
+    for ( const uint32_t i : placed )
+    {
+        transient_buffers.push_back( std::make_unique<const Buffer>( resources[i].usage, transient_allocation.memory, transient_allocation.offset + offsets[i], resources[i].size ) );
+        resources[i].buffer = transient_buffers.back()->buffer;
+    }
+}
+
+void FrameGraph::compute_barriers( const std::vector<uint32_t>& first_level, const std::vector<uint32_t>& last_level, const std::vector<VkDeviceSize>& offsets, const std::vector<VkDeviceSize>& sizes )
+{
+    std::vector<ResourceState> states( resources.size() );
+
+    for ( uint32_t level_index = 0; level_index < levels.size(); level_index++ )
+    {
+        Level& level = levels[level_index];
+
+        // Every pass of the level is checked against the state before the level, so barriers for the same buffer merge
+        std::vector<BarrierMasks> masks( resources.size() );
+        BarrierMasks alias_masks {};
+
+        for ( const uint32_t pass_index : level.passes )
+        {
+            const Pass& pass = passes[pass_index];
+
+            // Until the graph writes an imported buffer, its accesses depend on what was recorded before the graph
+            for ( const BufferAccess& read : pass.reads )
+            {
+                Resource& resource = resources[read.buffer];
+                if ( resource.sync_state != nullptr && !resource.written )
+                {
+                    resource.entry_read.stage |= read.stage;
+                    resource.entry_read.access |= read.access;
+                }
+            }
+            for ( const BufferAccess& write : pass.writes )
+            {
+                Resource& resource = resources[write.buffer];
+                if ( resource.sync_state != nullptr && !resource.written )
+                {
+                    resource.entry_write.stage |= write.stage;
+                    resource.entry_write.access |= write.access;
+                }
+            }
+
+            for ( const BufferAccess& read : pass.reads )
+            {
+                const ResourceState& state = states[read.buffer];
+                const bool visible = ( state.visible_stage & read.stage ) == read.stage && ( state.visible_access & read.access ) == read.access;
+
+                if ( state.write_stage != VK_PIPELINE_STAGE_2_NONE && !visible )
+                {
+                    masks[read.buffer].src_stage |= state.write_stage;
+                    masks[read.buffer].src_access |= state.write_access;
+                    masks[read.buffer].dst_stage |= read.stage;
+                    masks[read.buffer].dst_access |= read.access;
+                }
+            }
+
+            for ( const BufferAccess& write : pass.writes )
+            {
+                const ResourceState& state = states[write.buffer];
+
+                // Write after read only needs the reads to have executed
+                if ( state.read_stage != VK_PIPELINE_STAGE_2_NONE )
+                {
+                    masks[write.buffer].src_stage |= state.read_stage;
+                    masks[write.buffer].dst_stage |= write.stage;
+                }
+
+                if ( state.write_stage != VK_PIPELINE_STAGE_2_NONE )
+                {
+                    masks[write.buffer].src_stage |= state.write_stage;
+                    masks[write.buffer].src_access |= state.write_access;
+                    masks[write.buffer].dst_stage |= write.stage;
+                    masks[write.buffer].dst_access |= write.access;
+                }
+            }
+
+            // A transient starting here reuses memory of transients that are dead by now
+            for ( const std::vector<BufferAccess>* const accesses : { &pass.reads, &pass.writes } )
+            {
+                for ( const BufferAccess& access : *accesses )
+                {
+                    if ( !resources[access.buffer].transient || first_level[access.buffer] != level_index )
+                        continue;
+
+                    for ( uint32_t other = 0; other < resources.size(); other++ )
+                    {
+                        if ( !resources[other].transient || first_level[other] == UINT32_MAX || last_level[other] >= level_index )
+                            continue;
+
+                        const bool aliased = offsets[access.buffer] < offsets[other] + sizes[other] && offsets[other] < offsets[access.buffer] + sizes[access.buffer];
+                        if ( !aliased )
+                            continue;
+
+                        alias_masks.src_stage |= states[other].all_stages;
+                        alias_masks.src_access |= states[other].all_write_access;
+                        alias_masks.dst_stage |= access.stage;
+                        alias_masks.dst_access |= access.access;
+                    }
+                }
+            }
+        }
+
+        for ( uint32_t i = 0; i < resources.size(); i++ )
+        {
+            if ( masks[i].src_stage == VK_PIPELINE_STAGE_2_NONE )
+                continue;
+
+            level.buffer_barriers.push_back( make_buffer_barrier( resources[i].buffer, masks[i] ) );
+
+            // The barrier made the last write available to its destination
+            if ( masks[i].src_access & states[i].write_access )
+            {
+                states[i].visible_stage |= masks[i].dst_stage;
+                states[i].visible_access |= masks[i].dst_access;
+            }
+        }
+
+        level.alias_barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+            .pNext = nullptr,
+            .srcStageMask = alias_masks.src_stage,
+            .srcAccessMask = alias_masks.src_access,
+            .dstStageMask = alias_masks.dst_stage,
+            .dstAccessMask = alias_masks.dst_access,
+        };
+
+        // Reads first, a pass that also writes the buffer leaves it in the written state
+        for ( const uint32_t pass_index : level.passes )
+        {
+            for ( const BufferAccess& read : passes[pass_index].reads )
+            {
+                states[read.buffer].read_stage |= read.stage;
+                states[read.buffer].all_stages |= read.stage;
+            }
+        }
+
+        // Conflicting writes are in different levels, so all writes of a buffer here come from one pass
+        std::vector<BufferAccess> level_writes( resources.size() );
+        for ( const uint32_t pass_index : level.passes )
+        {
+            for ( const BufferAccess& write : passes[pass_index].writes )
+            {
+                level_writes[write.buffer].stage |= write.stage;
+                level_writes[write.buffer].access |= write.access;
+            }
+        }
+
+        for ( uint32_t i = 0; i < resources.size(); i++ )
+        {
+            if ( level_writes[i].stage == VK_PIPELINE_STAGE_2_NONE )
+                continue;
+
+            resources[i].written = true;
+
+            ResourceState& state = states[i];
+            state.write_stage = level_writes[i].stage;
+            state.write_access = level_writes[i].access;
+            state.read_stage = VK_PIPELINE_STAGE_2_NONE;
+            state.visible_stage = VK_PIPELINE_STAGE_2_NONE;
+            state.visible_access = VK_ACCESS_2_NONE;
+            state.all_stages |= level_writes[i].stage;
+            state.all_write_access |= level_writes[i].access;
+        }
+    }
+
+    for ( uint32_t i = 0; i < resources.size(); i++ )
+    {
+        Resource& resource = resources[i];
+        if ( resource.transient || !resource.written )
+            continue;
+
+        resource.exit_state = {
+            .write_stage = states[i].write_stage,
+            .write_access = states[i].write_access,
+            .read_stage = states[i].read_stage,
+            .visible_stage = states[i].visible_stage,
+            .visible_access = states[i].visible_access,
+        };
+
+        if ( resource.final_stage == VK_PIPELINE_STAGE_2_NONE )
+            continue;
+
+        final_barriers.push_back( make_buffer_barrier( resource.buffer, {
+            .src_stage = states[i].write_stage,
+            .src_access = states[i].write_access,
+            .dst_stage = resource.final_stage,
+            .dst_access = resource.final_access,
+        } ) );
+
+        resource.exit_state.visible_stage |= resource.final_stage;
+        resource.exit_state.visible_access |= resource.final_access;
+    }
+}
+
+void FrameGraph::compile()
+{
+    ASSERT( !compiled, "Frame graph is already compiled!\n" );
+
+    const std::vector<bool> live = cull_passes();
+    const std::vector<uint32_t> pass_levels = assign_levels( live );
+
+    for ( uint32_t i = 0; i < passes.size(); i++ )
+    {
+        if ( !live[i] )
+            continue;
+
+        if ( levels.size() <= pass_levels[i] )
+            levels.resize( pass_levels[i] + 1 );
+
+        levels[pass_levels[i]].passes.push_back( i );
+    }
+
+    // Lifetimes in levels, UINT32_MAX when no live pass uses the buffer
+    std::vector<uint32_t> first_level( resources.size(), UINT32_MAX );
+    std::vector<uint32_t> last_level( resources.size(), 0 );
+
+    for ( uint32_t i = 0; i < passes.size(); i++ )
+    {
+        if ( !live[i] )
+            continue;
+
+        for ( const std::vector<BufferAccess>* const accesses : { &passes[i].reads, &passes[i].writes } )
+        {
+            for ( const BufferAccess& access : *accesses )
+            {
+                first_level[access.buffer] = std::min( first_level[access.buffer], pass_levels[i] );
+                last_level[access.buffer] = std::max( last_level[access.buffer], pass_levels[i] );
+            }
+        }
+    }
+
+    std::vector<VkDeviceSize> offsets;
+    std::vector<VkDeviceSize> sizes;
+    place_transients( first_level, last_level, offsets, sizes );
+    compute_barriers( first_level, last_level, offsets, sizes );
+
+    compiled = true;
+
+    const uint32_t live_count = static_cast<uint32_t>( std::count( live.begin(), live.end(), true ) );
+    if ( live_count < passes.size() )
+    {
+        LOG( "Frame graph culled %u of %zu passes\n", static_cast<uint32_t>( passes.size() ) - live_count, passes.size() );
+    }
+}
+
+void FrameGraph::execute( const VkCommandBuffer cmd_buff ) const
+{
+    vkn::BarrierBatch barrier_batch;
+    execute( cmd_buff, barrier_batch );
+}
+
+void FrameGraph::execute( const VkCommandBuffer cmd_buff, vkn::BarrierBatch& barrier_batch ) const
+{
+    assert( compiled );
+
+    // Nothing in the graph precedes the first level, so the entry barriers only have to follow sync_state
+    for ( const Resource& resource : resources )
+    {
+        if ( resource.sync_state == nullptr )
+            continue;
+
+        if ( resource.entry_read.stage != VK_PIPELINE_STAGE_2_NONE )
+            vkn::use_buffer( barrier_batch, *resource.sync_state, resource.buffer, resource.entry_read.stage, resource.entry_read.access );
+        if ( resource.entry_write.stage != VK_PIPELINE_STAGE_2_NONE )
+            vkn::use_buffer( barrier_batch, *resource.sync_state, resource.buffer, resource.entry_write.stage, resource.entry_write.access );
+    }
+
+    vkn::flush_barriers( cmd_buff, barrier_batch );
+
+    for ( const Level& level : levels )
+    {
+        const bool has_alias_barrier = ( level.alias_barrier.srcStageMask != VK_PIPELINE_STAGE_2_NONE );
+        emit_barriers( cmd_buff, has_alias_barrier ? &level.alias_barrier : nullptr, level.buffer_barriers );
+
+        for ( const uint32_t pass_index : level.passes )
+            passes[pass_index].record( cmd_buff );
+    }
+
+    emit_barriers( cmd_buff, nullptr, final_barriers );
+
+    // Buffers the graph only reads already had their reads added by the entry barriers
+    for ( const Resource& resource : resources )
+    {
+        if ( resource.sync_state == nullptr || !resource.written )
+            continue;
+
+        const uint32_t queue_family_index = resource.sync_state->queue_family_index;
+        *resource.sync_state = resource.exit_state;
+        resource.sync_state->queue_family_index = queue_family_index;
+    }
+}
+
+VkBuffer FrameGraph::get_buffer( const ResourceId id ) const
+{
+    assert( compiled && id < resources.size() );
+    return resources[id].buffer;
+}
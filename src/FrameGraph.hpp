@@ -0,0 +1,117 @@
+#ifndef FRAME_GRAPH_HPP
+#define FRAME_GRAPH_HPP
+
+#include "vkn.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Buffer;
+
+// Compute frame graph. Passes declare the buffers they read and write, compile() orders them into levels of
+// independent passes, culls passes nothing kept depends on and precomputes one merged vkCmdPipelineBarrier2
+// per level. Transient buffers are placed in one device local allocation, buffers whose lifetimes do not
+// overlap share memory.
+//
+// Imported buffers are tracked through their Buffer::sync_state, the same state vkn::use_buffer() works on:
+// execute() synchronizes the graph's first accesses against it and leaves it as the graph left the buffer.
+// Build the graph once, execute it any number of times.
+class FrameGraph
+{
+public:
+    using ResourceId = uint32_t;
+    using RecordFunction = std::function<void( const VkCommandBuffer cmd_buff )>;
+
+    struct BufferAccess
+    {
+        ResourceId buffer { UINT32_MAX };
+        VkPipelineStageFlags2 stage { VK_PIPELINE_STAGE_2_NONE };
+        VkAccessFlags2 access { VK_ACCESS_2_NONE };
+    };
+private:
+    struct Resource
+    {
+        std::string name;
+        VkBuffer buffer { VK_NULL_HANDLE };
+        VkDeviceSize size { 0 };
+        VkBufferUsageFlags usage { 0x0 };   // transient only
+        bool transient { false };
+        bool keep { false };                // passes writing it are never culled
+
+        // Access made visible after the last level, imported buffers only
+        VkPipelineStageFlags2 final_stage { VK_PIPELINE_STAGE_2_NONE };
+        VkAccessFlags2 final_access { VK_ACCESS_2_NONE };
+
+        // Imported buffers only. Accesses up to and including the graph's first write are synchronized against
+        // sync_state, a buffer the graph writes is left in exit_state.
+        vkn::BufferSyncState* sync_state { nullptr };
+        BufferAccess entry_read {};
+        BufferAccess entry_write {};
+        bool written { false };
+        vkn::BufferSyncState exit_state {};
+    };
+
+    struct Pass
+    {
+        std::string name;
+        std::vector<BufferAccess> reads;
+        std::vector<BufferAccess> writes;
+        RecordFunction record;
+        bool side_effect { false };     // never culled, e.g. a pass writing host memory the graph does not know about
+    };
+
+    struct Level
+    {
+        std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+        VkMemoryBarrier2 alias_barrier {};      // ordering after the previous users of aliased memory, unused when no stages are set
+        std::vector<uint32_t> passes;
+    };
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+
+    bool compiled { false };
+    std::vector<Level> levels;
+    std::vector<VkBufferMemoryBarrier2> final_barriers;
+
+    vkn::Allocation transient_allocation {};
+    std::vector<std::unique_ptr<const Buffer>> transient_buffers;
+
+    std::vector<bool> cull_passes() const;
+    std::vector<uint32_t> assign_levels( const std::vector<bool>& live ) const;
+    void place_transients( const std::vector<uint32_t>& first_level, const std::vector<uint32_t>& last_level, std::vector<VkDeviceSize>& offsets, std::vector<VkDeviceSize>& sizes );
+    void compute_barriers( const std::vector<uint32_t>& first_level, const std::vector<uint32_t>& last_level, const std::vector<VkDeviceSize>& offsets, const std::vector<VkDeviceSize>& sizes );
+public:
+    FrameGraph() = default;
+    ~FrameGraph();
+
+    FrameGraph( const FrameGraph& ) = delete;
+    FrameGraph& operator=( const FrameGraph& ) = delete;
+
+    // final_stage/final_access is the access waited for after the graph (e.g. HOST / HOST_READ for a readback).
+    // Passes writing a kept buffer are roots of the graph.
+    ResourceId import_buffer( const char* const name, const Buffer& buffer, const bool keep, const VkPipelineStageFlags2 final_stage = VK_PIPELINE_STAGE_2_NONE, const VkAccessFlags2 final_access = VK_ACCESS_2_NONE );
+
+    // Created by compile(), contents are undefined at the first write of every execution
+    ResourceId create_transient_buffer( const char* const name, const VkBufferUsageFlags usage, const VkDeviceSize size );
+
+    // A buffer that is read and written is listed in both. Passes run in declaration order unless independent.
+    void add_pass( const char* const name, const std::vector<BufferAccess>& reads, const std::vector<BufferAccess>& writes, const RecordFunction& record, const bool side_effect = false );
+
+    void compile();
+    void execute( const VkCommandBuffer cmd_buff ) const;
+    // The entry barriers go out in one vkCmdPipelineBarrier2 with the barriers already in barrier_batch
+    void execute( const VkCommandBuffer cmd_buff, vkn::BarrierBatch& barrier_batch ) const;
+
+    // Only valid after compile(), VK_NULL_HANDLE for culled transients
+    VkBuffer get_buffer( const ResourceId id ) const;
+
+    uint32_t get_level_count() const { return static_cast<uint32_t>( levels.size() ); }
+    VkDeviceSize get_transient_memory_size() const { return transient_allocation.size; }
+};
+
+#endif // FRAME_GRAPH_HPP
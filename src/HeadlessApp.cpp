@@ -0,0 +1,186 @@
+#include "HeadlessApp.hpp"
+#include "ParallelRecorder.hpp"
+#include "vkn.hpp"
+#include "vkn_profiler.hpp"
+#include "defines.hpp"
+
+#include "json_parser/json.hpp"
+
+#include <fstream>
+#include <chrono>
+
+void from_json(const nlohmann::json& j, ConfigInfoHeadless& c)
+{
+    j.at("iteration_count").get_to(c.iteration_count);
+    j.at("submissions_in_flight").get_to(c.submissions_in_flight);
+    c.profile_json_path = j.value("profile_json_path", "");
+    c.element_count = j.value("element_count", 0u);
+    c.submit_batch_size = j.value("submit_batch_size", 1u);
+    c.iterations_per_submit = j.value("iterations_per_submit", 1u);
+    c.reuse_command_buffers = j.value("reuse_command_buffers", false);
+    c.recording_threads = j.value("recording_threads", 0u);
+}
+
+ConfigInfoHeadless HeadlessApp::read_config( const std::string_view config_file_path )
+{
+    std::ifstream file( config_file_path.data() );
+    ASSERT( file.is_open(), "Failed to open init config file: %s\n", config_file_path.data() );
+    return nlohmann::json::parse( file ).at( "headless" ).get<ConfigInfoHeadless>();
+}
+
+HeadlessApp::HeadlessApp( const std::string_view config_file_path )
+    : BaseApp( config_file_path )
+{
+    assert( vkn::get_headless() == true );
+
+    const ConfigInfoHeadless config_info = read_config( config_file_path );
+
+    ASSERT( config_info.submissions_in_flight > 0, "Headless config requires at least one submission in flight!\n" );
+    ASSERT( config_info.iterations_per_submit > 0 && config_info.iteration_count % config_info.iterations_per_submit == 0, "Headless iteration count has to be a multiple of iterations_per_submit!\n" );
+    ASSERT( config_info.submit_batch_size > 0 && config_info.submit_batch_size <= config_info.submissions_in_flight, "Headless submit batch size has to be in [1, submissions_in_flight]!\n" );
+    // Secondaries are recorded for one submit only
+    ASSERT( config_info.recording_threads == 0 || !config_info.reuse_command_buffers, "Headless recording threads do not support command buffer reuse!\n" );
+
+    iteration_count = config_info.iteration_count;
+    profile_json_path = config_info.profile_json_path;
+    element_count = config_info.element_count;
+    submit_batch_size = config_info.submit_batch_size;
+    iterations_per_submit = config_info.iterations_per_submit;
+    reuse_command_buffers = config_info.reuse_command_buffers;
+    recording_threads = config_info.recording_threads;
+    submissions.resize( config_info.submissions_in_flight );
+
+    for ( InFlightSubmission& submission : submissions )
+    {
+        submission.cmd_pool = vkn::create_command_pool( VK_COMMAND_POOL_CREATE_TRANSIENT_BIT );
+        submission.cmd_buff = vkn::allocate_command_buffer( submission.cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY );
+    }
+}
+
+HeadlessApp::~HeadlessApp()
+{
+    for ( InFlightSubmission& submission : submissions )
+    {
+        vkn::destroy_command_pool( submission.cmd_pool );
+    }
+}
+
+void HeadlessApp::retire( const uint32_t slot )
+{
+    InFlightSubmission& submission = submissions[slot];
+
+    if ( submission.iteration == UINT32_MAX )
+        return;
+
+    // Flushes the batch first if it is still pending
+    vkn::wait_submit( submission.ticket );
+
+    complete_iteration( slot, submission.iteration );
+    submission.iteration = UINT32_MAX;
+}
+
+void HeadlessApp::run()
+{
+    assert( queue_family_index != VK_QUEUE_FAMILY_IGNORED );
+
+    // Every iteration of a submission opens its own scopes
+    vkn::profiler_init( get_submissions_in_flight(), queue_family_index, 64 * iterations_per_submit );
+
+    const VkCommandBufferBeginInfo cmd_buff_begin_info {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = nullptr,
+        .flags = reuse_command_buffers ? VkCommandBufferUsageFlags { 0x0 } : VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr,
+    };
+
+    // Orders every iteration of a submission after the previous one
+    const VkMemoryBarrier iteration_barrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+    };
+
+    // The app may have changed what it records since the last run()
+    for ( InFlightSubmission& submission : submissions )
+        submission.recorded = false;
+
+    // Secondaries are allocated for the family the iterations are submitted to
+    parallel_recorder.reset();
+    if ( recording_threads > 0 )
+        parallel_recorder = std::make_unique<ParallelRecorder>( get_submissions_in_flight(), queue_family_index, recording_threads );
+
+    const uint32_t submission_count = iteration_count / iterations_per_submit;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for ( uint32_t submission_index = 0; submission_index < submission_count; submission_index++ )
+    {
+        const uint32_t slot = submission_index % get_submissions_in_flight();
+        InFlightSubmission& submission = submissions[slot];
+        const uint32_t first_iteration = submission_index * iterations_per_submit;
+
+        // Only block when we are a full ring of submissions ahead of the GPU
+        retire( slot );
+
+        const bool resubmit = reuse_command_buffers && submission.recorded;
+        vkn::profiler_begin_frame( slot, resubmit );
+
+        if ( !resubmit )
+        {
+            vkn::reset_command_pool( submission.cmd_pool );
+            VK_CHECK( vkBeginCommandBuffer( submission.cmd_buff, &cmd_buff_begin_info ) );
+            prepare_submission( submission.cmd_buff, slot, first_iteration );
+
+            const auto record = [&]( const VkCommandBuffer cmd_buff, const uint32_t i ) {
+                if ( i > 0 )
+                    vkCmdPipelineBarrier( cmd_buff, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0x0, 1, &iteration_barrier, 0, nullptr, 0, nullptr );
+
+                record_iteration( cmd_buff, slot, first_iteration + i );
+            };
+
+            if ( parallel_recorder )
+            {
+                // The barrier is recorded at the start of the secondary, it still orders against the previous ones
+                parallel_recorder->record( submission.cmd_buff, slot, iterations_per_submit, [&]( const VkCommandBuffer cmd_buff, const uint32_t task_index, const uint32_t ) {
+                    record( cmd_buff, task_index );
+                } );
+            }
+            else
+            {
+                for ( uint32_t i = 0; i < iterations_per_submit; i++ )
+                    record( submission.cmd_buff, i );
+            }
+
+            VK_CHECK( vkEndCommandBuffer( submission.cmd_buff ) );
+            submission.recorded = true;
+        }
+
+        const uint32_t queue_index = ( pinned_queue_index != UINT32_MAX ) ? pinned_queue_index : vkn::select_queue( VK_QUEUE_COMPUTE_BIT, queue_family_index );
+        submission.ticket = vkn::enqueue_submit( queue_index, 1, &submission.cmd_buff, wait_semaphores );
+        submission.iteration = first_iteration + iterations_per_submit - 1;
+
+        wait_semaphores.clear();
+
+        if ( ( submission_index + 1 ) % submit_batch_size == 0 )
+            vkn::flush_submits();
+    }
+
+    vkn::flush_submits();
+
+    // Drain in submission order so complete_iteration sees iterations in order
+    for ( uint32_t i = 0; i < get_submissions_in_flight(); i++ )
+    {
+        retire( ( submission_count + i ) % get_submissions_in_flight() );
+    }
+
+    const double elapsed_ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+    LOG( "Executed %u iterations in %.3f ms (%.3f ms/iteration)\n", iteration_count, elapsed_ms, iteration_count > 0 ? elapsed_ms / iteration_count : 0.0 );
+
+    // The drained submissions' timestamps would otherwise only be read when their slots are begun again
+    vkn::profiler_collect_all();
+
+    vkn::profiler_log_stats();
+    if ( !profile_json_path.empty() )
+        vkn::profiler_dump_json( profile_json_path );
+}
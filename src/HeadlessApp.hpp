@@ -1,9 +1,94 @@
 #ifndef HEADLESS_APP_HPP
 #define HEADLESS_APP_HPP
 
-struct HeadlessApp
+#include "BaseApp.hpp"
+#include "vkn.hpp"
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <string_view>
+
+class ParallelRecorder;
+
+struct ConfigInfoHeadless
 {
+    uint32_t iteration_count = 0;
+    uint32_t submissions_in_flight = 0;
+    std::string profile_json_path;  // optional, GPU scope statistics are written here after run()
+    uint32_t element_count = 0;     // optional, 0 leaves the input size to the app
+    uint32_t submit_batch_size = 1; // optional, submissions collected before the scheduler flushes them
+    uint32_t iterations_per_submit = 1; // optional, iterations recorded back to back into one submission
+    bool reuse_command_buffers = false; // optional, every slot is recorded once and resubmitted unchanged
+    uint32_t recording_threads = 0;     // optional, threads recording a submission's iterations, 0 records them inline
+};
+
+// Compute-only run loop. Requires a config without a "swapchain" block; the "headless" block controls
+// how many iterations are executed and how many submissions may be in flight at once.
+//
+// A submission holds iterations_per_submit iterations separated by a full memory barrier. With
+// reuse_command_buffers a slot's command buffer is only recorded for its first submission of a run() and
+// resubmitted afterwards, so the recorded commands must not depend on the iteration. With recording_threads
+// every iteration is recorded into its own secondary command buffer by a ParallelRecorder, record_iteration()
+// then runs concurrently for the iterations of a submission.
+struct HeadlessApp : public BaseApp
+{
+private:
+    struct InFlightSubmission
+    {
+        VkCommandPool cmd_pool { VK_NULL_HANDLE };
+        VkCommandBuffer cmd_buff { VK_NULL_HANDLE };
+        vkn::SubmitTicket ticket {};
+        uint32_t iteration { UINT32_MAX }; // last iteration of the pending submission, UINT32_MAX when there is none
+        bool recorded { false };           // cmd_buff holds commands that may be resubmitted
+    };
+
+    uint32_t iteration_count { 0 };
+    std::vector<InFlightSubmission> submissions;
+    uint32_t queue_family_index { VK_QUEUE_FAMILY_IGNORED };
+    uint32_t pinned_queue_index { UINT32_MAX };    // UINT32_MAX lets the scheduler pick any queue of the family
+    uint32_t submit_batch_size { 1 };
+    uint32_t iterations_per_submit { 1 };
+    bool reuse_command_buffers { false };
+    uint32_t recording_threads { 0 };
+    std::unique_ptr<ParallelRecorder> parallel_recorder { nullptr };
+    std::string profile_json_path;
+    uint32_t element_count { 0 };
+
+    std::vector<vkn::SemaphoreSubmit> wait_semaphores;
+
+    void retire( const uint32_t slot );
+protected:
+    // Every iteration is submitted to the given queue, needed when the app relies on ordering within the queue
+    void set_queue( const uint32_t queue_index ) { pinned_queue_index = queue_index; queue_family_index = vkn::get_queue_family_index( queue_index ); }
+    // Iterations are spread over the configured queues of the family
+    void set_queue_family( const uint32_t _queue_family_index ) { pinned_queue_index = UINT32_MAX; queue_family_index = _queue_family_index; }
+    uint32_t get_submissions_in_flight() const { return static_cast<uint32_t>( submissions.size() ); }
+    uint32_t get_element_count() const { return element_count; }
+    uint32_t get_iterations_per_submit() const { return iterations_per_submit; }
+    bool get_reuse_command_buffers() const { return reuse_command_buffers; }
+    uint32_t get_recording_threads() const { return recording_threads; }
+
+    // Makes the submission of the iteration currently being recorded wait on the semaphore
+    void add_wait_semaphore( const VkSemaphore semaphore, const VkPipelineStageFlags stage ) { wait_semaphores.push_back( { .semaphore = semaphore, .value = 0, .stage = stage } ); }
+    void run();
+
+    // Called on the submitting thread before the iterations of a recorded submission, the place for uploads,
+    // add_wait_semaphore() and commands all iterations depend on when they are recorded in parallel. cmd_buff is the
+    // submission's primary, the iterations follow it. The slot's previous submission has been retired.
+    virtual void prepare_submission( const VkCommandBuffer cmd_buff, const uint32_t slot, const uint32_t first_iteration ) {}
+
+    // Records one iteration into a command buffer owned by the slot. The slot's previous submission has been retired.
+    virtual void record_iteration( const VkCommandBuffer cmd_buff, const uint32_t slot, const uint32_t iteration ) = 0;
+
+    // Called once the GPU has finished the submission previously made for the slot, with its last iteration.
+    virtual void complete_iteration( const uint32_t slot, const uint32_t iteration ) = 0;
+public:
+    HeadlessApp( const std::string_view config_file_path );
+    ~HeadlessApp();
 
+    static ConfigInfoHeadless read_config( const std::string_view config_file_path );
 };
 
-#endif // HEADLESS_APP_HPP
\ No newline at end of file
+#endif // HEADLESS_APP_HPP
@@ -0,0 +1,66 @@
+#include "HostApp.hpp"
+#include "HeadlessApp.hpp"
+#include "HostArraySum.hpp"
+#include "ArraySum.hpp"
+#include "vkn.hpp"
+#include "vkn_profiler.hpp"
+#include "defines.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+static uint32_t get_config_element_count( const ConfigInfoHeadless& config_info )
+{
+    return ( config_info.element_count > 0 ) ? config_info.element_count : ArraySum::num_elements_to_sum;
+}
+
+bool HostApp::is_preferred( const std::string_view config_file_path )
+{
+    if ( get_config_element_count( HeadlessApp::read_config( config_file_path ) ) < HostArraySum::min_device_element_count )
+        return true;
+
+    if ( !vkn::is_device_available() )
+    {
+        LOG( "No Vulkan 1.3 compute device found, falling back to the CPU backend\n" );
+        return true;
+    }
+
+    return false;
+}
+
+HostApp::HostApp( const std::string_view config_file_path )
+{
+    const ConfigInfoHeadless config_info = HeadlessApp::read_config( config_file_path );
+    ASSERT( config_info.submissions_in_flight > 0, "Headless config requires at least one submission in flight!\n" );
+
+    const uint32_t slot_count = config_info.submissions_in_flight;
+    host_array_sum = std::make_unique<HostArraySum>( slot_count, get_config_element_count( config_info ) );
+
+    // Host inputs stay valid between runs, unlike the GPU path there is nothing to stream per iteration
+    for ( uint32_t i = 0; i < slot_count; i++ )
+        host_array_sum->upload_input( i );
+
+    std::vector<double> iteration_ms;
+    iteration_ms.reserve( config_info.iteration_count );
+
+    for ( uint32_t iteration = 0; iteration < config_info.iteration_count; iteration++ )
+    {
+        const uint32_t slot = iteration % slot_count;
+
+        const auto start = std::chrono::steady_clock::now();
+        host_array_sum->run( slot );
+        iteration_ms.push_back( std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count() );
+
+        const uint32_t sum = host_array_sum->read_result( slot );
+        LOG( "Iteration %u Sum: %u%s\n", iteration, sum, ( sum == host_array_sum->get_expected_result() ) ? "" : " (MISMATCH)" );
+    }
+
+    std::sort( iteration_ms.begin(), iteration_ms.end() );
+    LOG( "Executed %u iterations on %u threads (%s): median %.4f ms, p90 %.4f ms, p99 %.4f ms\n", config_info.iteration_count, host_array_sum->get_thread_count(),
+        HostArraySum::get_simd_name(), vkn::get_percentile( iteration_ms, 0.5 ), vkn::get_percentile( iteration_ms, 0.9 ), vkn::get_percentile( iteration_ms, 0.99 ) );
+}
+
+HostApp::~HostApp()
+{
+}
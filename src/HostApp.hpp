@@ -0,0 +1,22 @@
+#ifndef HOST_APP_HPP
+#define HOST_APP_HPP
+
+#include <memory>
+#include <string_view>
+
+class HostArraySum;
+
+// Runs a headless config on the CPU backend without touching Vulkan. Used when there is no usable device or
+// when the configured input is too small to be worth a submit.
+class HostApp
+{
+private:
+    std::unique_ptr<HostArraySum> host_array_sum { nullptr };
+public:
+    HostApp( const std::string_view config_file_path );
+    ~HostApp();
+
+    static bool is_preferred( const std::string_view config_file_path );
+};
+
+#endif // HOST_APP_HPP
@@ -0,0 +1,268 @@
+#include "HostArraySum.hpp"
+#include "ThreadPool.hpp"
+#include "defines.hpp"
+
+#include <algorithm>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+#define HOST_SUM_X86
+#elif defined( __ARM_NEON )
+#include <arm_neon.h>
+#define HOST_SUM_NEON
+#endif
+
+namespace
+{
+
+using SumFunction = uint32_t (*)( const uint32_t* const, const size_t );
+
+static constexpr uint32_t cache_line_elements = 64 / sizeof( uint32_t );
+
+// Independent accumulators everywhere so the adds are not serialised on one register
+static uint32_t sum_scalar( const uint32_t* const data, const size_t count )
+{
+    uint32_t sums[4] = { 0, 0, 0, 0 };
+
+    size_t i = 0;
+    for ( ; i + 4 <= count; i += 4 )
+    {
+        sums[0] += data[i + 0];
+        sums[1] += data[i + 1];
+        sums[2] += data[i + 2];
+        sums[3] += data[i + 3];
+    }
+
+    for ( ; i < count; i++ )
+        sums[0] += data[i];
+
+    return sums[0] + sums[1] + sums[2] + sums[3];
+}
+
+#ifdef HOST_SUM_X86
+__attribute__(( target( "avx2" ) ))
+static uint32_t sum_avx2( const uint32_t* const data, const size_t count )
+{
+    __m256i acc[4] = { _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256() };
+
+    size_t i = 0;
+    for ( ; i + 32 <= count; i += 32 )
+    {
+        for ( uint32_t j = 0; j < 4; j++ )
+            acc[j] = _mm256_add_epi32( acc[j], _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data + i + j * 8 ) ) );
+    }
+
+    const __m256i total = _mm256_add_epi32( _mm256_add_epi32( acc[0], acc[1] ), _mm256_add_epi32( acc[2], acc[3] ) );
+    __m128i lanes = _mm_add_epi32( _mm256_castsi256_si128( total ), _mm256_extracti128_si256( total, 1 ) );
+    lanes = _mm_add_epi32( lanes, _mm_shuffle_epi32( lanes, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+    lanes = _mm_add_epi32( lanes, _mm_shuffle_epi32( lanes, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+
+    return static_cast<uint32_t>( _mm_cvtsi128_si32( lanes ) ) + sum_scalar( data + i, count - i );
+}
+
+__attribute__(( target( "avx512f" ) ))
+static uint32_t sum_avx512( const uint32_t* const data, const size_t count )
+{
+    __m512i acc[4] = { _mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512() };
+
+    size_t i = 0;
+    for ( ; i + 64 <= count; i += 64 )
+    {
+        for ( uint32_t j = 0; j < 4; j++ )
+            acc[j] = _mm512_add_epi32( acc[j], _mm512_loadu_si512( data + i + j * 16 ) );
+    }
+
+    alignas( 64 ) uint32_t lanes[16];
+    _mm512_store_si512( lanes, _mm512_add_epi32( _mm512_add_epi32( acc[0], acc[1] ), _mm512_add_epi32( acc[2], acc[3] ) ) );
+
+    uint32_t sum = 0;
+    for ( const uint32_t lane : lanes )
+        sum += lane;
+
+    return sum + sum_scalar( data + i, count - i );
+}
+#endif
+
+#ifdef HOST_SUM_NEON
+static uint32_t sum_neon( const uint32_t* const data, const size_t count )
+{
+    uint32x4_t acc[4] = { vdupq_n_u32( 0 ), vdupq_n_u32( 0 ), vdupq_n_u32( 0 ), vdupq_n_u32( 0 ) };
+
+    size_t i = 0;
+    for ( ; i + 16 <= count; i += 16 )
+    {
+        for ( uint32_t j = 0; j < 4; j++ )
+            acc[j] = vaddq_u32( acc[j], vld1q_u32( data + i + j * 4 ) );
+    }
+
+    const uint32x4_t total = vaddq_u32( vaddq_u32( acc[0], acc[1] ), vaddq_u32( acc[2], acc[3] ) );
+    const uint32_t lanes = vgetq_lane_u32( total, 0 ) + vgetq_lane_u32( total, 1 ) + vgetq_lane_u32( total, 2 ) + vgetq_lane_u32( total, 3 );
+
+    return lanes + sum_scalar( data + i, count - i );
+}
+#endif
+
+struct SumPath
+{
+    SumFunction function { nullptr };
+    const char* name { nullptr };
+};
+
+static SumPath select_sum_path()
+{
+#ifdef HOST_SUM_X86
+    __builtin_cpu_init();
+
+    if ( __builtin_cpu_supports( "avx512f" ) )
+        return { sum_avx512, "AVX-512" };
+
+    if ( __builtin_cpu_supports( "avx2" ) )
+        return { sum_avx2, "AVX2" };
+#endif
+
+#ifdef HOST_SUM_NEON
+    return { sum_neon, "NEON" };
+#endif
+
+    return { sum_scalar, "scalar" };
+}
+
+static const SumPath& get_sum_path()
+{
+    static const SumPath sum_path = select_sum_path();
+    return sum_path;
+}
+
+}
+
+uint32_t HostArraySum::get_reference_sum( const uint32_t count )
+{
+    // Every full period of 0..255 adds 32640, the reference wraps modulo 2^32 like the kernels
+    const uint64_t full_periods = count / 256;
+    const uint64_t remainder = count % 256;
+    return static_cast<uint32_t>( full_periods * 32640 + ( remainder * ( remainder - 1 ) ) / 2 );
+}
+
+const char* HostArraySum::get_simd_name()
+{
+    return get_sum_path().name;
+}
+
+HostArraySum::HostArraySum( const uint32_t _slot_count, const uint32_t _element_capacity, const uint32_t thread_count )
+    : slot_count { _slot_count }
+    , element_capacity { _element_capacity }
+{
+    assert( slot_count > 0 && element_capacity > 0 );
+
+    // Pinned so each worker's first-touched slice of the inputs stays on its NUMA node
+    thread_pool = std::make_unique<ThreadPool>( thread_count, true );
+
+    inputs.resize( slot_count );
+    uploaded_counts.resize( slot_count, 0 );
+    results.resize( slot_count, 0 );
+    partial_sums.resize( thread_pool->get_thread_count() * cache_line_elements, 0 );
+
+    set_element_count( element_capacity );
+
+    LOG( "Host array sum: %u threads, %s\n", thread_pool->get_thread_count(), get_simd_name() );
+}
+
+HostArraySum::~HostArraySum()
+{
+}
+
+uint32_t HostArraySum::get_thread_count() const
+{
+    return thread_pool->get_thread_count();
+}
+
+void HostArraySum::set_element_count( const uint32_t count )
+{
+    ASSERT( count > 0 && count <= element_capacity, "HostArraySum element count %u out of range!\n", count );
+
+    element_count = count;
+    expected_result = get_reference_sum( count );
+}
+
+void HostArraySum::get_thread_range( const uint32_t thread_index, const uint32_t first, const uint32_t count, uint32_t& begin, uint32_t& end ) const
+{
+    // Whole blocks per thread, a thread without a block idles instead of waking up for a few elements
+    const uint64_t block_count = ( static_cast<uint64_t>( count ) + block_element_count - 1 ) / block_element_count;
+    const uint64_t thread_count = thread_pool->get_thread_count();
+
+    begin = first + static_cast<uint32_t>( std::min<uint64_t>( block_count * thread_index / thread_count * block_element_count, count ) );
+    end = first + static_cast<uint32_t>( std::min<uint64_t>( block_count * ( thread_index + 1 ) / thread_count * block_element_count, count ) );
+}
+
+void HostArraySum::upload_input( const uint32_t slot )
+{
+    // new[] leaves the pages untouched, they are placed by the threads writing them below
+    if ( !inputs.at( slot ) )
+        inputs[slot] = std::unique_ptr<uint32_t[]>( new uint32_t[element_capacity] );
+
+    uint32_t* const input = inputs[slot].get();
+    const uint32_t count = element_count;
+
+    const auto upload_range = [input]( const uint32_t begin, const uint32_t end )
+    {
+        for ( uint32_t i = begin; i < end; i++ )
+            input[i] = get_input_element( i );
+    };
+
+    // Same split as run(), so every thread sums the pages it placed
+    if ( count <= block_element_count )
+    {
+        upload_range( 0, count );
+    }
+    else
+    {
+        thread_pool->run( [&]( const uint32_t thread_index )
+        {
+            uint32_t begin = 0;
+            uint32_t end = 0;
+            get_thread_range( thread_index, 0, count, begin, end );
+            upload_range( begin, end );
+        } );
+    }
+
+    uploaded_counts[slot] = count;
+}
+
+void HostArraySum::run( const uint32_t slot )
+{
+    run( slot, 0, element_count );
+}
+
+void HostArraySum::run( const uint32_t slot, const uint32_t first, const uint32_t count )
+{
+    ASSERT( static_cast<uint64_t>( first ) + count <= uploaded_counts.at( slot ), "HostArraySum slot %u has to be uploaded before it is run!\n", slot );
+
+    const uint32_t* const input = inputs[slot].get();
+    const SumFunction sum_function = get_sum_path().function;
+
+    // Small inputs are not worth waking the pool for
+    if ( count <= block_element_count )
+    {
+        results[slot] = ( count > 0 ) ? sum_function( input + first, count ) : 0;
+        return;
+    }
+
+    thread_pool->run( [&]( const uint32_t thread_index )
+    {
+        uint32_t begin = 0;
+        uint32_t end = 0;
+        get_thread_range( thread_index, first, count, begin, end );
+
+        uint32_t sum = 0;
+        for ( uint32_t block_begin = begin; block_begin < end; block_begin += block_element_count )
+            sum += sum_function( input + block_begin, std::min( block_element_count, end - block_begin ) );
+
+        partial_sums[thread_index * cache_line_elements] = sum;
+    } );
+
+    uint32_t sum = 0;
+    for ( uint32_t i = 0; i < thread_pool->get_thread_count(); i++ )
+        sum += partial_sums[i * cache_line_elements];
+
+    results[slot] = sum;
+}
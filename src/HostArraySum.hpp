@@ -0,0 +1,68 @@
+#ifndef HOST_ARRAY_SUM_HPP
+#define HOST_ARRAY_SUM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+// CPU counterpart of ArraySum with the same slot based flow: upload_input() -> run() -> read_result(). The input
+// is split into one contiguous range per thread. A thread writes and later sums only its own range, so with first
+// touch placement its pages stay on its NUMA node. Ranges are walked in cache sized blocks with the widest SIMD
+// the CPU supports. Small inputs are summed on the calling thread.
+class HostArraySum
+{
+private:
+    const uint32_t slot_count { 0 };
+    const uint32_t element_capacity { 0 };
+
+    std::unique_ptr<ThreadPool> thread_pool { nullptr };
+
+    std::vector<std::unique_ptr<uint32_t[]>> inputs;
+    std::vector<uint32_t> uploaded_counts;
+    std::vector<uint32_t> results;
+    std::vector<uint32_t> partial_sums;     // one cache line per thread
+
+    uint32_t element_count { 0 };
+    uint32_t expected_result { 0 };
+
+    // Range [begin, end) of [first, first + count) thread_index owns
+    void get_thread_range( const uint32_t thread_index, const uint32_t first, const uint32_t count, uint32_t& begin, uint32_t& end ) const;
+public:
+    // Below this many elements submit and readback latency outweigh the device's bandwidth
+    static constexpr uint32_t min_device_element_count = ( 1 << 16 );
+    static constexpr uint32_t block_element_count = ( 256 << 10 ) / sizeof( uint32_t );
+
+    // The array_sum input, shared by both backends
+    static uint32_t get_input_element( const uint64_t index ) { return static_cast<uint32_t>( index & 0xFF ); }
+    // Sum of the first count input elements modulo 2^32, in closed form
+    static uint32_t get_reference_sum( const uint32_t count );
+    // Name of the SIMD path selected for this CPU
+    static const char* get_simd_name();
+
+    // 0 threads uses every hardware thread
+    HostArraySum( const uint32_t _slot_count, const uint32_t _element_capacity, const uint32_t thread_count = 0 );
+    ~HostArraySum();
+
+    void set_element_count( const uint32_t count );
+    uint32_t get_element_count() const { return element_count; }
+    uint32_t get_element_capacity() const { return element_capacity; }
+    uint32_t get_thread_count() const;
+
+    // Writes the input into the slot's array. The first upload of a slot places its pages, so upload at the
+    // element count that is summed most.
+    void upload_input( const uint32_t slot );
+
+    // Sums the slot's input, blocks until done
+    void run( const uint32_t slot );
+    // Sums elements [first, first + count) of the slot's input, blocks until done. Safe to call from any thread,
+    // but only one run may be in progress at a time.
+    void run( const uint32_t slot, const uint32_t first, const uint32_t count );
+
+    uint32_t read_result( const uint32_t slot ) const { return results.at( slot ); }
+    uint32_t get_expected_result() const { return expected_result; }
+};
+
+#endif // HOST_ARRAY_SUM_HPP
@@ -0,0 +1,167 @@
+#include "HybridApp.hpp"
+#include "ArraySum.hpp"
+#include "HostArraySum.hpp"
+#include "vkn.hpp"
+#include "vkn_profiler.hpp"
+#include "defines.hpp"
+
+#include "json_parser/json.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+
+struct ConfigInfoHybrid
+{
+    double initial_gpu_fraction = 0.5;
+    double smoothing = 0.25;
+};
+
+void from_json(const nlohmann::json& j, ConfigInfoHybrid& c)
+{
+    c.initial_gpu_fraction = j.value("initial_gpu_fraction", 0.5);
+    c.smoothing = j.value("smoothing", 0.25);
+}
+
+static ConfigInfoHybrid read_hybrid_config( const std::string_view config_file_path )
+{
+    std::ifstream file( config_file_path.data() );
+    ASSERT( file.is_open(), "Failed to open init config file: %s\n", config_file_path.data() );
+    return nlohmann::json::parse( file ).at( "hybrid" ).get<ConfigInfoHybrid>();
+}
+
+// Both sides always keep a share, otherwise a side that fell to zero could never be measured again
+static constexpr double min_share = 0.02;
+
+HybridApp::HybridApp( const std::string_view config_file_path )
+    : HeadlessApp( config_file_path )
+{
+    const ConfigInfoHybrid config_info = read_hybrid_config( config_file_path );
+    ASSERT( config_info.smoothing > 0.0 && config_info.smoothing <= 1.0, "Hybrid smoothing has to be in (0, 1]!\n" );
+    // The split changes every iteration and is derived from that iteration's dispatch time
+    ASSERT( HeadlessApp::get_iterations_per_submit() == 1 && !HeadlessApp::get_reuse_command_buffers(), "Hybrid mode requires one iteration per submit without command buffer reuse!\n" );
+
+    gpu_fraction = std::clamp( config_info.initial_gpu_fraction, min_share, 1.0 - min_share );
+    smoothing = config_info.smoothing;
+    element_count = ( HeadlessApp::get_element_count() > 0 ) ? HeadlessApp::get_element_count() : ArraySum::num_elements_to_sum;
+
+    // Same queue layout as ComputeApp, queue 1 (if configured) streams the device share
+    const uint32_t upload_queue_index = ( vkn::get_queue_count() > 1 ) ? 1 : 0;
+
+    array_sum = std::make_unique<ArraySum>( HeadlessApp::get_submissions_in_flight(), vkn::get_queue_family_index( 0 ), vkn::get_queue( upload_queue_index ), vkn::get_queue_family_index( upload_queue_index ), element_count );
+
+    if ( upload_queue_index != 0 )
+    {
+        for ( uint32_t i = 0; i < HeadlessApp::get_submissions_in_flight(); i++ )
+            upload_semaphores.push_back( vkn::create_semaphore() );
+    }
+
+    // The host array never changes, one slot serves every iteration
+    host_array_sum = std::make_unique<HostArraySum>( 1, element_count );
+    host_array_sum->upload_input( 0 );
+
+    slot_splits.resize( HeadlessApp::get_submissions_in_flight() );
+
+    HeadlessApp::set_queue_family( vkn::get_queue_family_index( 0 ) );
+    HeadlessApp::run();
+
+    LOG( "Final split: %.1f%% device, %.1f%% host\n", 100.0 * gpu_fraction, 100.0 * ( 1.0 - gpu_fraction ) );
+}
+
+HybridApp::~HybridApp()
+{
+    finish_cpu_job();
+
+    for ( const VkSemaphore semaphore : upload_semaphores )
+        vkn::destroy_semaphore( semaphore );
+}
+
+void HybridApp::finish_cpu_job()
+{
+    if ( cpu_job_slot == UINT32_MAX )
+        return;
+
+    const CpuResult result = cpu_job.get();
+    slot_splits[cpu_job_slot].cpu_sum = result.sum;
+    slot_splits[cpu_job_slot].cpu_ms = result.ms;
+    cpu_job_slot = UINT32_MAX;
+}
+
+void HybridApp::update_split( const SlotSplit& split, const double dispatch_ms )
+{
+    const uint32_t cpu_count = element_count - split.gpu_count;
+
+    // The device side costs its upload plus the dispatch, the host side only its sum
+    const double gpu_ms = split.upload_ms + dispatch_ms;
+    if ( gpu_ms <= 0.0 || split.cpu_ms <= 0.0 || split.gpu_count == 0 || cpu_count == 0 )
+        return;
+
+    const double gpu_rate = static_cast<double>( split.gpu_count ) / gpu_ms;
+    const double cpu_rate = static_cast<double>( cpu_count ) / split.cpu_ms;
+
+    // Both sides finish together when each gets a share proportional to its rate
+    const double target = gpu_rate / ( gpu_rate + cpu_rate );
+    gpu_fraction = std::clamp( gpu_fraction + smoothing * ( target - gpu_fraction ), min_share, 1.0 - min_share );
+}
+
+void HybridApp::record_iteration( const VkCommandBuffer cmd_buff, const uint32_t slot, const uint32_t iteration )
+{
+    finish_cpu_job();
+
+    // begin_frame has just collected the slot's previous timestamps, so the last dispatch time belongs to it
+    SlotSplit& split = slot_splits[slot];
+    if ( split.measured )
+    {
+        for ( const vkn::GpuRegionStats& stats : vkn::profiler_get_stats() )
+        {
+            if ( stats.name == "dispatch" )
+                update_split( split, stats.last_ms );
+        }
+
+        split.measured = false;
+    }
+
+    split.gpu_count = std::clamp<uint32_t>( static_cast<uint32_t>( std::lround( gpu_fraction * element_count ) ), 1, element_count );
+    const uint32_t cpu_first = split.gpu_count;
+    const uint32_t cpu_count = element_count - split.gpu_count;
+
+    // The host share starts before the upload, so both stream from memory at the same time
+    cpu_job = std::async( std::launch::async, [this, cpu_first, cpu_count]()
+    {
+        const auto start = std::chrono::steady_clock::now();
+        host_array_sum->run( 0, cpu_first, cpu_count );
+        return CpuResult {
+            .sum = host_array_sum->read_result( 0 ),
+            .ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count(),
+        };
+    } );
+    cpu_job_slot = slot;
+
+    const VkSemaphore upload_semaphore = upload_semaphores.empty() ? VK_NULL_HANDLE : upload_semaphores[slot];
+
+    const auto upload_start = std::chrono::steady_clock::now();
+    array_sum->set_element_count( split.gpu_count );
+    array_sum->upload_input( slot, upload_semaphore );
+    split.upload_ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - upload_start ).count();
+
+    if ( upload_semaphore != VK_NULL_HANDLE )
+        HeadlessApp::add_wait_semaphore( upload_semaphore, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT );
+
+    array_sum->record( cmd_buff, slot );
+}
+
+void HybridApp::complete_iteration( const uint32_t slot, const uint32_t iteration )
+{
+    if ( cpu_job_slot == slot )
+        finish_cpu_job();
+
+    SlotSplit& split = slot_splits[slot];
+    split.measured = true;
+
+    // Both partial sums wrap modulo 2^32, so does their sum
+    const uint32_t sum = array_sum->read_result( slot ) + split.cpu_sum;
+    const uint32_t expected = HostArraySum::get_reference_sum( element_count );
+
+    LOG( "Iteration %u Sum: %u (device %u, host %u elements)%s\n", iteration, sum, split.gpu_count, element_count - split.gpu_count, ( sum == expected ) ? "" : " (MISMATCH)" );
+}
@@ -0,0 +1,60 @@
+#ifndef HYBRID_APP_HPP
+#define HYBRID_APP_HPP
+
+#include "HeadlessApp.hpp"
+
+#include <vulkan/vulkan.h>
+#include <future>
+#include <memory>
+#include <vector>
+
+class ArraySum;
+class HostArraySum;
+
+// Headless config with a "hybrid" block. Every iteration splits one input between the device and the host: the
+// device sums the first part (streamed through ArraySum's staging upload), the host threads sum the rest straight
+// from the host array while that upload and the dispatch are running. The split follows the measured throughput
+// of both sides, the partial sums are merged once the iteration has retired.
+class HybridApp : public HeadlessApp
+{
+private:
+    struct SlotSplit
+    {
+        uint32_t gpu_count { 0 };
+        uint32_t cpu_sum { 0 };
+        double upload_ms { 0.0 };
+        double cpu_ms { 0.0 };
+        bool measured { false };    // the slot's previous iteration retired and has not been accounted yet
+    };
+
+    struct CpuResult
+    {
+        uint32_t sum { 0 };
+        double ms { 0.0 };
+    };
+
+    std::unique_ptr<ArraySum> array_sum { nullptr };
+    std::unique_ptr<HostArraySum> host_array_sum { nullptr };
+    std::vector<VkSemaphore> upload_semaphores;
+
+    uint32_t element_count { 0 };
+    double gpu_fraction { 0.5 };
+    double smoothing { 0.25 };
+
+    std::vector<SlotSplit> slot_splits;
+
+    // At most one host share is summed at a time
+    std::future<CpuResult> cpu_job;
+    uint32_t cpu_job_slot { UINT32_MAX };
+
+    void finish_cpu_job();
+    void update_split( const SlotSplit& split, const double dispatch_ms );
+
+    virtual void record_iteration( const VkCommandBuffer cmd_buff, const uint32_t slot, const uint32_t iteration ) override final;
+    virtual void complete_iteration( const uint32_t slot, const uint32_t iteration ) override final;
+public:
+    HybridApp( const std::string_view config_file_path );
+    ~HybridApp();
+};
+
+#endif // HYBRID_APP_HPP
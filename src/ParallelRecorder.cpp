@@ -0,0 +1,98 @@
+#include "ParallelRecorder.hpp"
+#include "ThreadPool.hpp"
+#include "vkn.hpp"
+#include "defines.hpp"
+
+ParallelRecorder::ParallelRecorder( const uint32_t frame_count, const uint32_t _queue_family_index, const uint32_t thread_count )
+    : queue_family_index { _queue_family_index }
+    , thread_pool { std::make_unique<ThreadPool>( thread_count ) }
+{
+    ASSERT( frame_count > 0, "ParallelRecorder requires at least one frame slot!\n" );
+
+    frames.resize( frame_count );
+    for ( std::vector<ThreadFrame>& thread_frames : frames )
+    {
+        thread_frames.resize( thread_pool->get_thread_count() );
+        for ( ThreadFrame& thread_frame : thread_frames )
+            thread_frame.cmd_pool = vkn::create_command_pool( VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, queue_family_index );
+    }
+}
+
+ParallelRecorder::~ParallelRecorder()
+{
+    // Destroying a pool frees its command buffers
+    for ( std::vector<ThreadFrame>& thread_frames : frames )
+    {
+        for ( ThreadFrame& thread_frame : thread_frames )
+            vkn::destroy_command_pool( thread_frame.cmd_pool );
+    }
+}
+
+uint32_t ParallelRecorder::get_thread_count() const
+{
+    return thread_pool->get_thread_count();
+}
+
+void ParallelRecorder::record( const VkCommandBuffer primary_cmd_buff, const uint32_t frame_index, const uint32_t task_count, const RecordTask& record_task )
+{
+    assert( frame_index < frames.size() );
+
+    if ( task_count == 0 )
+        return;
+
+    std::vector<ThreadFrame>& thread_frames = frames[frame_index];
+    task_cmd_buffs.assign( task_count, VK_NULL_HANDLE );
+
+    const VkCommandBufferInheritanceInfo inheritance_info {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext = nullptr,
+        .renderPass = VK_NULL_HANDLE,
+        .subpass = 0,
+        .framebuffer = VK_NULL_HANDLE,
+        .occlusionQueryEnable = VK_FALSE,
+        .queryFlags = 0x0,
+        .pipelineStatistics = 0x0,
+    };
+
+    const VkCommandBufferBeginInfo cmd_buff_begin_info {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = nullptr,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = &inheritance_info,
+    };
+
+    const uint32_t thread_count = static_cast<uint32_t>( thread_frames.size() );
+
+    thread_pool->run( [&]( const uint32_t thread_index ) {
+        // Contiguous task ranges, independent of scheduling
+        const uint32_t first_task = static_cast<uint32_t>( static_cast<uint64_t>( task_count ) * thread_index / thread_count );
+        const uint32_t end_task = static_cast<uint32_t>( static_cast<uint64_t>( task_count ) * ( thread_index + 1 ) / thread_count );
+        if ( first_task == end_task )
+            return;
+
+        ThreadFrame& thread_frame = thread_frames[thread_index];
+
+        // Recycles every secondary the thread recorded for this slot last time
+        vkn::reset_command_pool( thread_frame.cmd_pool );
+
+        const uint32_t needed = end_task - first_task;
+        if ( thread_frame.cmd_buffs.size() < needed )
+        {
+            const std::vector<VkCommandBuffer> allocated = vkn::allocate_command_buffers( thread_frame.cmd_pool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, needed - static_cast<uint32_t>( thread_frame.cmd_buffs.size() ) );
+            thread_frame.cmd_buffs.insert( thread_frame.cmd_buffs.end(), allocated.begin(), allocated.end() );
+        }
+
+        for ( uint32_t task = first_task; task < end_task; task++ )
+        {
+            const VkCommandBuffer cmd_buff = thread_frame.cmd_buffs[task - first_task];
+
+            VK_CHECK( vkBeginCommandBuffer( cmd_buff, &cmd_buff_begin_info ) );
+            record_task( cmd_buff, task, thread_index );
+            VK_CHECK( vkEndCommandBuffer( cmd_buff ) );
+
+            task_cmd_buffs[task] = cmd_buff;
+        }
+    } );
+
+    vkCmdExecuteCommands( primary_cmd_buff, task_count, task_cmd_buffs.data() );
+}
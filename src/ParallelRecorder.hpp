@@ -0,0 +1,51 @@
+#ifndef PARALLEL_RECORDER_HPP
+#define PARALLEL_RECORDER_HPP
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+// Records independent command sequences on a pool of threads. Every thread owns one transient command pool per
+// frame slot and the secondary command buffers allocated from it, so threads never share a pool. Tasks are split
+// into contiguous ranges per thread and their secondaries are executed in task order, the primary is the same
+// whatever the thread count.
+//
+// A slot's pools are reset when the slot is recorded again, so its previous submission must have completed
+// (same contract as vkn::profiler_begin_frame). Secondaries inherit no state: every task binds its own pipeline
+// and descriptor sets. Tasks run concurrently, anything they share besides vkn::GpuScope has to be synchronized.
+class ParallelRecorder
+{
+private:
+    struct ThreadFrame
+    {
+        VkCommandPool cmd_pool { VK_NULL_HANDLE };
+        std::vector<VkCommandBuffer> cmd_buffs;     // grows to the most tasks the thread recorded for the slot
+    };
+
+    const uint32_t queue_family_index { 0 };
+    std::unique_ptr<ThreadPool> thread_pool { nullptr };
+
+    std::vector<std::vector<ThreadFrame>> frames;   // [frame slot][thread]
+    std::vector<VkCommandBuffer> task_cmd_buffs;    // secondaries of the current record(), in task order
+public:
+    using RecordTask = std::function<void( const VkCommandBuffer cmd_buff, const uint32_t task_index, const uint32_t thread_index )>;
+
+    // thread_count 0 uses every hardware thread
+    ParallelRecorder( const uint32_t frame_count, const uint32_t _queue_family_index, const uint32_t thread_count = 0 );
+    ~ParallelRecorder();
+
+    ParallelRecorder( const ParallelRecorder& ) = delete;
+    ParallelRecorder& operator=( const ParallelRecorder& ) = delete;
+
+    uint32_t get_thread_count() const;
+
+    // Records task_count secondaries with record_task and executes them in the primary, which has to be recording
+    // outside of a render pass.
+    void record( const VkCommandBuffer primary_cmd_buff, const uint32_t frame_index, const uint32_t task_count, const RecordTask& record_task );
+};
+
+#endif // PARALLEL_RECORDER_HPP
@@ -0,0 +1,134 @@
+#include "ReadbackRing.hpp"
+#include "Buffer.hpp"
+#include "vkn.hpp"
+#include "defines.hpp"
+
+#include <algorithm>
+
+static VkMemoryPropertyFlags select_readback_memory_properties()
+{
+    const VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    const VkPhysicalDeviceMemoryProperties& mem_props = vkn::get_physical_device_memory_properties();
+
+    for ( uint32_t i = 0; i < mem_props.memoryTypeCount; i++ )
+    {
+        if ( ( mem_props.memoryTypes[i].propertyFlags & cached ) == cached )
+            return cached;
+    }
+
+    return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+static VkDeviceSize align_up( const VkDeviceSize value, const VkDeviceSize alignment )
+{
+    return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+ReadbackRing::ReadbackRing( const uint32_t _slot_count, const VkDeviceSize _slot_size )
+    : slot_count { _slot_count }
+    , slot_size { _slot_size }
+{
+    assert( slot_count > 0 && slot_size > 0 );
+
+    // Slot buffers are placed at multiples of the stride, so it also has to satisfy their alignment
+    const VkBuffer probe_buffer = vkn::create_buffer( VK_BUFFER_USAGE_TRANSFER_DST_BIT, slot_size );
+    const VkDeviceSize alignment = std::max( vkn::get_buffer_memory_requirements( probe_buffer ).alignment, vkn::get_physical_device_properties().limits.nonCoherentAtomSize );
+    vkn::destroy_buffer( probe_buffer );
+
+    slot_stride = align_up( slot_size, alignment );
+
+    buffer = std::make_unique<const Buffer>( VK_BUFFER_USAGE_TRANSFER_DST_BIT, select_readback_memory_properties(), slot_stride * slot_count );
+    host_coherent = ( vkn::get_memory_property_flags( buffer->allocation ) & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT ) != 0;
+
+    slot_buffers.reserve( slot_count );
+    for ( uint32_t i = 0; i < slot_count; i++ )
+        slot_buffers.push_back( std::make_unique<const Buffer>( VK_BUFFER_USAGE_TRANSFER_DST_BIT, buffer->memory, buffer->memory_offset + i * slot_stride, slot_size ) );
+
+    slot_pending.resize( slot_count, false );
+}
+
+ReadbackRing::~ReadbackRing()
+{
+    // The owner has waited for its submissions, results nobody polled for are dropped
+    if ( !pending.empty() )
+    {
+        LOG( "WARNING - %zu readback(s) were never delivered!\n", pending.size() );
+    }
+}
+
+const Buffer& ReadbackRing::get_buffer( const uint32_t slot ) const
+{
+    assert( slot < slot_count );
+    return *slot_buffers[slot];
+}
+
+bool ReadbackRing::is_complete( const PendingReadback& readback ) const
+{
+    return vkn::get_semaphore_counter_value( readback.timeline ) >= readback.value;
+}
+
+void ReadbackRing::deliver_front()
+{
+    const PendingReadback readback = std::move( pending.front() );
+    pending.pop_front();
+    slot_pending[readback.slot] = false;
+
+    if ( readback.callback )
+        readback.callback( readback.slot, read( readback.slot ) );
+}
+
+void ReadbackRing::submit( const uint32_t slot, const VkSemaphore timeline, const uint64_t value, const Callback& callback )
+{
+    assert( slot < slot_count );
+
+    if ( slot_pending[slot] )
+        wait( slot );
+
+    pending.push_back( {
+        .slot = slot,
+        .timeline = timeline,
+        .value = value,
+        .callback = callback,
+    } );
+
+    slot_pending[slot] = true;
+}
+
+void ReadbackRing::poll()
+{
+    // In order, a later submission on another timeline may finish first but is delivered after the earlier ones
+    while ( !pending.empty() && is_complete( pending.front() ) )
+        deliver_front();
+}
+
+void ReadbackRing::wait( const uint32_t slot )
+{
+    assert( slot < slot_count );
+
+    while ( slot_pending[slot] )
+    {
+        const PendingReadback& readback = pending.front();
+        vkn::wait_semaphore( readback.timeline, readback.value );
+        deliver_front();
+    }
+}
+
+void ReadbackRing::wait_idle()
+{
+    while ( !pending.empty() )
+    {
+        const PendingReadback& readback = pending.front();
+        vkn::wait_semaphore( readback.timeline, readback.value );
+        deliver_front();
+    }
+}
+
+const void* ReadbackRing::read( const uint32_t slot ) const
+{
+    assert( slot < slot_count );
+
+    if ( !host_coherent )
+        vkn::invalidate_mapped_memory( buffer->memory, buffer->memory_offset + slot * slot_stride, slot_stride );
+
+    return static_cast<const uint8_t*>( buffer->get_mapped_ptr() ) + slot * slot_stride;
+}
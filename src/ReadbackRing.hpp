@@ -0,0 +1,70 @@
+#ifndef READBACK_RING_HPP
+#define READBACK_RING_HPP
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+struct Buffer;
+
+// Persistently mapped host memory GPU results are copied into, one fixed region per slot. Host reads of uncached
+// memory are slow, so HOST_CACHED memory is preferred, it is invalidated before reading only when not coherent.
+//
+// A slot is tagged with the timeline value of the submission writing it, poll() hands the results that have
+// arrived to their callbacks without ever blocking. The host only waits for a result it asks for with wait().
+class ReadbackRing
+{
+public:
+    using Callback = std::function<void( const uint32_t slot, const void* const data )>;
+private:
+    struct PendingReadback
+    {
+        uint32_t slot { 0 };
+        VkSemaphore timeline { VK_NULL_HANDLE };
+        uint64_t value { 0 };
+        Callback callback;
+    };
+
+    const uint32_t slot_count { 0 };
+    const VkDeviceSize slot_size { 0 };
+    VkDeviceSize slot_stride { 0 };         // nonCoherentAtomSize multiple, slots are invalidated independently
+
+    std::unique_ptr<const Buffer> buffer { nullptr };                   // owns the mapped memory
+    std::vector<std::unique_ptr<const Buffer>> slot_buffers;            // placed in it, every slot tracks its own sync state
+    bool host_coherent { false };
+
+    std::deque<PendingReadback> pending;    // submission order
+    std::vector<bool> slot_pending;
+
+    bool is_complete( const PendingReadback& readback ) const;
+    void deliver_front();
+public:
+    ReadbackRing( const uint32_t _slot_count, const VkDeviceSize _slot_size );
+    ~ReadbackRing();
+
+    ReadbackRing( const ReadbackRing& ) = delete;
+    ReadbackRing& operator=( const ReadbackRing& ) = delete;
+
+    // Copy destination of a slot, written at offset 0. Make the copy visible to the host (HOST / HOST_READ) before
+    // the submission ends.
+    const Buffer& get_buffer( const uint32_t slot ) const;
+
+    // The submission signalling value on timeline writes the slot, callback receives the result from poll()
+    // or wait(). A result of the slot that is still pending is delivered first, waiting for it if necessary.
+    void submit( const uint32_t slot, const VkSemaphore timeline, const uint64_t value, const Callback& callback );
+
+    // Delivers the results that have arrived in submission order, never blocks
+    void poll();
+
+    // Delivers every result up to and including the slot's
+    void wait( const uint32_t slot );
+    void wait_idle();
+
+    // Untagged access, only valid once the submission that wrote the slot has completed
+    const void* read( const uint32_t slot ) const;
+};
+
+#endif // READBACK_RING_HPP
@@ -0,0 +1,120 @@
+#include "ShardedApp.hpp"
+#include "HeadlessApp.hpp"
+#include "ArraySum.hpp"
+#include "HostArraySum.hpp"
+#include "vkn.hpp"
+#include "vkn_profiler.hpp"
+#include "defines.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+ShardedApp::ShardedApp( const std::string_view config_file_path )
+    : BaseApp( config_file_path )
+{
+    assert( vkn::get_headless() == true );
+
+    const ConfigInfoHeadless config_info = HeadlessApp::read_config( config_file_path );
+    element_count = ( config_info.element_count > 0 ) ? config_info.element_count : ArraySum::num_elements_to_sum;
+
+    // Even split, devices beyond the last shard stay idle for tiny inputs
+    const uint32_t device_count = vkn::get_device_count();
+    const uint32_t shard_size = static_cast<uint32_t>( ( static_cast<uint64_t>( element_count ) + device_count - 1 ) / device_count );
+
+    for ( uint32_t i = 0, first = 0; i < device_count && first < element_count; i++, first += shard_size )
+    {
+        vkn::set_current_device( i );
+
+        DeviceShard shard {
+            .device_index = i,
+            .first_element = first,
+            .element_count = std::min( shard_size, element_count - first ),
+            .queue = vkn::get_queue( 0 ),
+        };
+
+        shard.array_sum = std::make_unique<ArraySum>( 1, vkn::get_queue_family_index( 0 ), shard.queue, vkn::get_queue_family_index( 0 ), shard.element_count );
+        shard.array_sum->set_first_element( shard.first_element );
+        shard.cmd_pool = vkn::create_command_pool( VK_COMMAND_POOL_CREATE_TRANSIENT_BIT );
+        shard.cmd_buff = vkn::allocate_command_buffer( shard.cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY );
+        shard.fence = vkn::create_fence();
+
+        LOG( "Device %u (%s): elements [%u, %u)\n", i, vkn::get_physical_device_properties().deviceName, shard.first_element, shard.first_element + shard.element_count );
+        shards.push_back( std::move( shard ) );
+    }
+
+    std::vector<double> iteration_ms;
+    iteration_ms.reserve( config_info.iteration_count );
+
+    const uint32_t expected = HostArraySum::get_reference_sum( element_count );
+
+    for ( uint32_t iteration = 0; iteration < config_info.iteration_count; iteration++ )
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        // Submit to every device before waiting on any, so all of them work at the same time
+        for ( DeviceShard& shard : shards )
+            record_and_submit( shard );
+
+        uint32_t sum = 0;
+        for ( DeviceShard& shard : shards )
+        {
+            vkn::set_current_device( shard.device_index );
+            vkn::wait_for_fence( shard.fence, UINT64_MAX );
+            vkn::reset_fence( shard.fence );
+
+            // Partial sums wrap modulo 2^32, so does their sum
+            const uint32_t partial_sum = shard.array_sum->read_result( 0 );
+            if ( partial_sum != shard.array_sum->get_expected_result() )
+                LOG( "Iteration %u device %u partial sum: %u (MISMATCH, expected %u)\n", iteration, shard.device_index, partial_sum, shard.array_sum->get_expected_result() );
+            sum += partial_sum;
+        }
+
+        iteration_ms.push_back( std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count() );
+        LOG( "Iteration %u Sum: %u%s\n", iteration, sum, ( sum == expected ) ? "" : " (MISMATCH)" );
+    }
+
+    vkn::set_current_device( 0 );
+
+    std::sort( iteration_ms.begin(), iteration_ms.end() );
+    LOG( "Executed %u iterations on %zu device(s): median %.4f ms, p90 %.4f ms, p99 %.4f ms\n", config_info.iteration_count, shards.size(),
+        vkn::get_percentile( iteration_ms, 0.5 ), vkn::get_percentile( iteration_ms, 0.9 ), vkn::get_percentile( iteration_ms, 0.99 ) );
+}
+
+ShardedApp::~ShardedApp()
+{
+    for ( DeviceShard& shard : shards )
+    {
+        vkn::set_current_device( shard.device_index );
+        vkn::device_wait_idle();
+
+        shard.array_sum.reset();
+        vkn::destroy_fence( shard.fence );
+        vkn::destroy_command_pool( shard.cmd_pool );
+    }
+
+    vkn::set_current_device( 0 );
+}
+
+void ShardedApp::record_and_submit( DeviceShard& shard )
+{
+    vkn::set_current_device( shard.device_index );
+
+    // The upload shares queue 0 with the dispatch and is submitted first, so no semaphore is needed
+    shard.array_sum->upload_input( 0 );
+
+    const VkCommandBufferBeginInfo cmd_buff_begin_info {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = nullptr,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr,
+    };
+
+    vkn::reset_command_pool( shard.cmd_pool );
+    VK_CHECK( vkBeginCommandBuffer( shard.cmd_buff, &cmd_buff_begin_info ) );
+
+    shard.array_sum->record( shard.cmd_buff, 0 );
+
+    VK_CHECK( vkEndCommandBuffer( shard.cmd_buff ) );
+
+    vkn::queue_submit( shard.queue, 1, &shard.cmd_buff, {}, {}, shard.fence );
+}
@@ -0,0 +1,39 @@
+#ifndef SHARDED_APP_HPP
+#define SHARDED_APP_HPP
+
+#include "BaseApp.hpp"
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+class ArraySum;
+
+// Headless config with "multi_device" in its device block. Every iteration splits the input into one shard per
+// vkn device, each device uploads and sums its shard on its own queue 0 and the partial sums are combined on the host.
+class ShardedApp : public BaseApp
+{
+private:
+    struct DeviceShard
+    {
+        uint32_t device_index { 0 };
+        uint32_t first_element { 0 };
+        uint32_t element_count { 0 };
+        std::unique_ptr<ArraySum> array_sum { nullptr };
+        VkQueue queue { VK_NULL_HANDLE };
+        VkCommandPool cmd_pool { VK_NULL_HANDLE };
+        VkCommandBuffer cmd_buff { VK_NULL_HANDLE };
+        VkFence fence { VK_NULL_HANDLE };
+    };
+
+    uint32_t element_count { 0 };
+    std::vector<DeviceShard> shards;
+
+    void record_and_submit( DeviceShard& shard );
+public:
+    ShardedApp( const std::string_view config_file_path );
+    ~ShardedApp();
+};
+
+#endif // SHARDED_APP_HPP
@@ -1,43 +1,256 @@
 #include "StagingBuffer.hpp"
 #include "Buffer.hpp"
 #include "vkn.hpp"
+#include "vkn_profiler.hpp"
 #include "defines.hpp"
 
 #include <string.h>
+#include <algorithm>
 
-StagingBuffer::StagingBuffer( const VkDeviceSize buffer_size )
+StagingBuffer::StagingBuffer( const VkQueue _queue, const uint32_t _queue_family_index, const VkDeviceSize buffer_size )
     : size { buffer_size }
     , buffer { std::make_unique<const Buffer>( VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size ) }
+    , queue { _queue }
+    , queue_family_index { _queue_family_index }
 {
-    vkn::map_memory( buffer->memory, 0, size, (void**)(&mapped_ptr) );
+    mapped_ptr = static_cast<uint8_t*>( buffer->get_mapped_ptr() );
+}
+
+StagingBuffer::~StagingBuffer()
+{
+    wait_idle();
+
+    for ( Submission& submission : submissions )
+    {
+        vkn::destroy_fence( submission.fence );
+        vkn::destroy_command_pool( submission.cmd_pool );
+    }
+}
+
+VkDeviceSize StagingBuffer::get_contiguous_free() const
+{
+    if ( used == size )
+        return 0;
+
+    // Free space either runs from head to the end of the ring, or from head up to tail once head has wrapped
+    return ( head >= tail ) ? size - head : tail - head;
 }
 
 void StagingBuffer::queue_upload( const VkBuffer dst_buffer, const VkDeviceSize dst_buffer_offset, const VkDeviceSize upload_size, const void* const data )
 {
-    if ( offset + upload_size >= size )
+    const uint8_t* src = static_cast<const uint8_t*>( data );
+    VkDeviceSize uploaded = 0;
+
+    while ( uploaded < upload_size )
     {
-        EXIT("Attempting to upload more data than staging buffer can store!\n");
+        retire_completed();
+
+        if ( used == 0 )
+        {
+            // Nothing outstanding, restart at the beginning to maximise contiguous space
+            head = 0;
+            tail = 0;
+        }
+        else if ( head == size && tail > 0 )
+        {
+            head = 0;
+        }
+
+        const VkDeviceSize contiguous_free = get_contiguous_free();
+
+        if ( contiguous_free == 0 )
+        {
+            // Ring is full, get the GPU started on what we have and wait for the oldest region to drain.
+            // Ownership is only released by the caller's flush, once every chunk has been copied.
+            std::vector<VkBufferMemoryBarrier> no_acquires;
+            submit( VK_NULL_HANDLE, VK_QUEUE_FAMILY_IGNORED, no_acquires );
+            retire_oldest( true );
+            continue;
+        }
+
+        const VkDeviceSize chunk_size = std::min( upload_size - uploaded, contiguous_free );
+
+        memcpy( mapped_ptr + head, src + uploaded, chunk_size );
+
+        const VkBufferCopy buff_copy {
+            .srcOffset = head,
+            .dstOffset = dst_buffer_offset + uploaded,
+            .size = chunk_size
+        };
+        queued_buffer_upload_infos[dst_buffer].push_back( std::move( buff_copy ) );
+
+        if ( std::find( unreleased_buffers.begin(), unreleased_buffers.end(), dst_buffer ) == unreleased_buffers.end() )
+            unreleased_buffers.push_back( dst_buffer );
+
+        head += chunk_size;
+        used += chunk_size;
+        pending_bytes += chunk_size;
+        uploaded += chunk_size;
     }
+}
 
-    memcpy(mapped_ptr + offset, data, upload_size);
+uint32_t StagingBuffer::acquire_submission()
+{
+    for ( uint32_t i = 0; i < submissions.size(); i++ )
+    {
+        if ( !submissions[i].in_use )
+        {
+            submissions[i].in_use = true;
+            return i;
+        }
+    }
 
-    const VkBufferCopy buff_copy {
-        .srcOffset = offset,
-        .dstOffset = dst_buffer_offset,
-        .size = upload_size
+    Submission submission {
+        .cmd_pool = vkn::create_command_pool( VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, queue_family_index ),
+        .cmd_buff = VK_NULL_HANDLE,
+        .fence = vkn::create_fence(),
+        .in_use = true,
     };
-    queued_buffer_upload_infos[dst_buffer].push_back( std::move( buff_copy ) );
+    submission.cmd_buff = vkn::allocate_command_buffer( submission.cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY );
+
+    submissions.push_back( submission );
+    return static_cast<uint32_t>( submissions.size() - 1 );
+}
 
-    offset += upload_size;
+std::vector<VkBufferMemoryBarrier> StagingBuffer::flush( const VkSemaphore signal_semaphore, const uint32_t dst_queue_family_index )
+{
+    // Internal chunk submissions pass VK_QUEUE_FAMILY_IGNORED to defer the release, a caller's flush never does
+    std::vector<VkBufferMemoryBarrier> acquire_barriers;
+    submit( signal_semaphore, ( dst_queue_family_index == VK_QUEUE_FAMILY_IGNORED ) ? queue_family_index : dst_queue_family_index, acquire_barriers );
+    return acquire_barriers;
 }
 
-void StagingBuffer::record_flush( const VkCommandBuffer cmd_buff )
+void StagingBuffer::submit( const VkSemaphore signal_semaphore, const uint32_t dst_queue_family_index, std::vector<VkBufferMemoryBarrier>& acquire_barriers )
 {
-    for ( const auto& [dst_buffer, uploads] : queued_buffer_upload_infos )
+    const bool transfer_ownership = ( dst_queue_family_index != VK_QUEUE_FAMILY_IGNORED ) && ( dst_queue_family_index != queue_family_index ) && !unreleased_buffers.empty();
+
+    // A semaphore must be signalled even without new data, the consumer is going to wait on it
+    if ( pending_bytes == 0 && signal_semaphore == VK_NULL_HANDLE && !transfer_ownership )
+        return;
+
+    const uint32_t submission_index = acquire_submission();
+    const Submission& submission = submissions[submission_index];
+
+    const VkCommandBufferBeginInfo cmd_buff_begin_info {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = nullptr,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr,
+    };
+
+    vkn::reset_command_pool( submission.cmd_pool );
+    VK_CHECK( vkBeginCommandBuffer( submission.cmd_buff, &cmd_buff_begin_info ) );
+
     {
-        vkCmdCopyBuffer( cmd_buff, buffer->buffer, dst_buffer, static_cast<uint32_t>( uploads.size() ), uploads.data() );
+        vkn::GpuScope scope( submission.cmd_buff, "staging copy", queue_family_index );
+
+        for ( const auto& [dst_buffer, uploads] : queued_buffer_upload_infos )
+        {
+            vkCmdCopyBuffer( submission.cmd_buff, buffer->buffer, dst_buffer, static_cast<uint32_t>( uploads.size() ), uploads.data() );
+        }
     }
 
+    if ( transfer_ownership )
+    {
+        // Release covers copies from earlier chunk submissions too, they precede it in submission order
+        std::vector<VkBufferMemoryBarrier> release_barriers;
+        release_barriers.reserve( unreleased_buffers.size() );
+
+        for ( const VkBuffer dst_buffer : unreleased_buffers )
+        {
+            release_barriers.push_back( vkn::make_buffer_ownership_barrier( dst_buffer, 0, VK_WHOLE_SIZE, queue_family_index, dst_queue_family_index, VK_ACCESS_TRANSFER_WRITE_BIT, 0x0 ) );
+            acquire_barriers.push_back( vkn::make_buffer_ownership_barrier( dst_buffer, 0, VK_WHOLE_SIZE, queue_family_index, dst_queue_family_index, 0x0, 0x0 ) );
+        }
+
+        vkCmdPipelineBarrier( submission.cmd_buff,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0x0,
+            0, nullptr,
+            static_cast<uint32_t>( release_barriers.size() ), release_barriers.data(),
+            0, nullptr );
+
+        unreleased_buffers.clear();
+    }
+    else
+    {
+        // The second scope of a barrier covers everything later in submission order, so this makes the copies
+        // visible to any work submitted to the queue after this flush.
+        const VkMemoryBarrier mem_barrier {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+        };
+
+        vkCmdPipelineBarrier( submission.cmd_buff,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0x0,
+            1, &mem_barrier,
+            0, nullptr,
+            0, nullptr );
+
+        if ( dst_queue_family_index == queue_family_index )
+            unreleased_buffers.clear();
+    }
+
+    VK_CHECK( vkEndCommandBuffer( submission.cmd_buff ) );
+
+    const VkSubmitInfo submit_info {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .waitSemaphoreCount = 0,
+        .pWaitSemaphores = nullptr,
+        .pWaitDstStageMask = nullptr,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &submission.cmd_buff,
+        .signalSemaphoreCount = ( signal_semaphore != VK_NULL_HANDLE ) ? 1u : 0u,
+        .pSignalSemaphores = &signal_semaphore,
+    };
+
+    VK_CHECK( vkQueueSubmit( queue, 1, &submit_info, submission.fence ) );
+
+    in_flight_regions.push_back( { .byte_count = pending_bytes, .submission_index = submission_index } );
+
     queued_buffer_upload_infos.clear();
-    offset = 0;
-}
\ No newline at end of file
+    pending_bytes = 0;
+}
+
+void StagingBuffer::retire_oldest( const bool wait )
+{
+    assert( !in_flight_regions.empty() );
+
+    const InFlightRegion region = in_flight_regions.front();
+    Submission& submission = submissions[region.submission_index];
+
+    if ( wait )
+        vkn::wait_for_fence( submission.fence, UINT64_MAX );
+
+    vkn::reset_fence( submission.fence );
+    submission.in_use = false;
+
+    // Regions are written and retired in ring order, so the tail simply advances past the region
+    tail += region.byte_count;
+    if ( tail >= size )
+        tail -= size;
+
+    used -= region.byte_count;
+    in_flight_regions.pop_front();
+}
+
+void StagingBuffer::retire_completed()
+{
+    while ( !in_flight_regions.empty() && vkn::is_fence_signaled( submissions[in_flight_regions.front().submission_index].fence ) )
+    {
+        retire_oldest( false );
+    }
+}
+
+void StagingBuffer::wait_idle()
+{
+    while ( !in_flight_regions.empty() )
+    {
+        retire_oldest( true );
+    }
+}
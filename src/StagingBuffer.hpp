@@ -3,26 +3,75 @@
 
 #include <vulkan/vulkan.h>
 
+#include <deque>
 #include <memory>
 #include <unordered_map>
 #include <vector>
 
 class Buffer;
 
+// Host visible ring used to stream uploads. Every flush is submitted with its own fence, and the ring region
+// it read from is only reused once that fence has signalled. Uploads larger than the free space are split into
+// chunks and flushed as the ring fills, so any upload size is accepted.
+//
+// The staging queue may belong to a different family than the consumer (e.g. a transfer-only family). In that
+// case flush() releases the written buffers to the consumer's family and returns the matching acquire barriers.
 struct StagingBuffer
 {
 private:
+    struct Submission
+    {
+        VkCommandPool cmd_pool { VK_NULL_HANDLE };
+        VkCommandBuffer cmd_buff { VK_NULL_HANDLE };
+        VkFence fence { VK_NULL_HANDLE };
+        bool in_use { false };
+    };
+
+    struct InFlightRegion
+    {
+        VkDeviceSize byte_count { 0 };
+        uint32_t submission_index { 0 };
+    };
+
     const VkDeviceSize size = 0lu;  
     const std::unique_ptr<const Buffer> buffer { nullptr };
+    const VkQueue queue { VK_NULL_HANDLE };
+    const uint32_t queue_family_index { VK_QUEUE_FAMILY_IGNORED };
 
     uint8_t* mapped_ptr = nullptr;
-    VkDeviceSize offset = 0lu;
+    VkDeviceSize head = 0lu;            // next byte to write
+    VkDeviceSize tail = 0lu;            // oldest byte the GPU may still read
+    VkDeviceSize used = 0lu;            // bytes between tail and head, pending or in flight
+    VkDeviceSize pending_bytes = 0lu;   // written but not yet flushed
 
     std::unordered_map<VkBuffer, std::vector<VkBufferCopy>> queued_buffer_upload_infos;
+    std::vector<VkBuffer> unreleased_buffers;   // written since the last ownership release
+
+    std::vector<Submission> submissions;
+    std::deque<InFlightRegion> in_flight_regions;
+
+    VkDeviceSize get_contiguous_free() const;
+    uint32_t acquire_submission();
+    void retire_oldest( const bool wait );
+    void submit( const VkSemaphore signal_semaphore, const uint32_t dst_queue_family_index, std::vector<VkBufferMemoryBarrier>& acquire_barriers );
 public:
-    StagingBuffer( const VkDeviceSize buffer_size );
+    StagingBuffer( const VkQueue _queue, const uint32_t _queue_family_index, const VkDeviceSize buffer_size );
+    ~StagingBuffer();
+
+    // Copies data into the ring. Blocks only when the ring is full of data the GPU has not consumed yet.
     void queue_upload( const VkBuffer dst_buffer, const VkDeviceSize dst_buffer_offset, const VkDeviceSize upload_size, const void* const data );
-    void record_flush( const VkCommandBuffer cmd_buff );
+
+    // Submits all queued copies. Work submitted afterwards to the same queue observes the uploaded data.
+    // Work on another queue must wait on signal_semaphore. When dst_queue_family_index differs from the staging
+    // family, every buffer written since the last release is released to it, and the returned acquire barriers
+    // (fill in dstAccessMask) must be recorded on the consumer queue before the data is used.
+    std::vector<VkBufferMemoryBarrier> flush( const VkSemaphore signal_semaphore = VK_NULL_HANDLE, const uint32_t dst_queue_family_index = VK_QUEUE_FAMILY_IGNORED );
+
+    // Releases regions whose submissions have completed, never blocks.
+    void retire_completed();
+
+    // Blocks until every flushed upload has completed.
+    void wait_idle();
 };
 
-#endif // STAGING_BUFFER_HPP
\ No newline at end of file
+#endif // STAGING_BUFFER_HPP
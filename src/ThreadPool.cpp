@@ -0,0 +1,106 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static std::vector<uint32_t> get_allowed_cpus()
+{
+    std::vector<uint32_t> cpus;
+
+#ifdef __linux__
+    // Respects taskset and cgroup restrictions, unlike hardware_concurrency()
+    cpu_set_t cpu_set;
+    CPU_ZERO( &cpu_set );
+    if ( sched_getaffinity( 0, sizeof( cpu_set ), &cpu_set ) == 0 )
+    {
+        for ( uint32_t cpu = 0; cpu < CPU_SETSIZE; cpu++ )
+        {
+            if ( CPU_ISSET( cpu, &cpu_set ) )
+                cpus.push_back( cpu );
+        }
+    }
+#endif
+
+    return cpus;
+}
+
+static void pin_thread( std::thread& thread, const uint32_t cpu )
+{
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO( &cpu_set );
+    CPU_SET( cpu, &cpu_set );
+    pthread_setaffinity_np( thread.native_handle(), sizeof( cpu_set ), &cpu_set );
+#endif
+}
+
+ThreadPool::ThreadPool( const uint32_t thread_count, const bool pin_workers )
+{
+    const std::vector<uint32_t> cpus = get_allowed_cpus();
+    const uint32_t available = cpus.empty() ? std::thread::hardware_concurrency() : static_cast<uint32_t>( cpus.size() );
+    const uint32_t count = ( thread_count > 0 ) ? thread_count : std::max( available, 1u );
+
+    workers.reserve( count - 1 );
+    for ( uint32_t i = 1; i < count; i++ )
+    {
+        workers.emplace_back( &ThreadPool::worker_loop, this, i );
+
+        if ( pin_workers && !cpus.empty() )
+            pin_thread( workers.back(), cpus[i % cpus.size()] );
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+        stopping = true;
+    }
+    start_cv.notify_all();
+
+    for ( std::thread& worker : workers )
+        worker.join();
+}
+
+void ThreadPool::worker_loop( const uint32_t thread_index )
+{
+    uint64_t seen_generation = 0;
+
+    for ( ;; )
+    {
+        {
+            std::unique_lock<std::mutex> lock( mutex );
+            start_cv.wait( lock, [&] { return stopping || generation != seen_generation; } );
+            if ( stopping )
+                return;
+
+            seen_generation = generation;
+        }
+
+        task( thread_index );
+
+        std::lock_guard<std::mutex> lock( mutex );
+        if ( --remaining == 0 )
+            done_cv.notify_one();
+    }
+}
+
+void ThreadPool::run( const std::function<void( const uint32_t )>& _task )
+{
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+        task = _task;
+        remaining = static_cast<uint32_t>( workers.size() );
+        generation++;
+    }
+    start_cv.notify_all();
+
+    task( 0 );
+
+    std::unique_lock<std::mutex> lock( mutex );
+    done_cv.wait( lock, [&] { return remaining == 0; } );
+}
@@ -0,0 +1,43 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that all run the same task. The calling thread takes part as thread 0, so a pool of
+// one thread runs the task inline. With pin_workers (Linux only) worker i is pinned to the i-th CPU the process may
+// run on, which keeps the pages a worker touched first on its own NUMA node for later runs. The calling thread is
+// never pinned, it keeps whatever affinity its owner gave it.
+class ThreadPool
+{
+private:
+    std::vector<std::thread> workers;
+    std::function<void( const uint32_t )> task;
+
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    uint64_t generation { 0 };
+    uint32_t remaining { 0 };
+    bool stopping { false };
+
+    void worker_loop( const uint32_t thread_index );
+public:
+    // 0 uses every CPU the process may run on
+    ThreadPool( const uint32_t thread_count = 0, const bool pin_workers = false );
+    ~ThreadPool();
+
+    ThreadPool( const ThreadPool& ) = delete;
+    ThreadPool& operator=( const ThreadPool& ) = delete;
+
+    uint32_t get_thread_count() const { return static_cast<uint32_t>( workers.size() ) + 1; }
+
+    // Calls task( thread_index ) once on every thread and returns when all calls have returned
+    void run( const std::function<void( const uint32_t )>& _task );
+};
+
+#endif // THREAD_POOL_HPP
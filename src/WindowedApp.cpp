@@ -1,43 +1,134 @@
 #include "WindowedApp.hpp"
+#include "Buffer.hpp"
 #include "vkn.hpp"
+#include "vkn_profiler.hpp"
+#include "defines.hpp"
 
 #include <GLFW/glfw3.h>
 #include <assert.h>
 
 WindowedApp::WindowedApp( const std::string_view config_file_path )
     : BaseApp( config_file_path )
-    , resource_count { vkn::get_frames_in_flight() }
-    , image_acquire_fences { vkn::get_frames_in_flight(), vkn::create_fence() }
     , glfw_window { vkn::get_glfw_window() }
+    , frames( vkn::get_frames_in_flight() )
     , active_resource_index { 0 }
+    , timeline { vkn::create_timeline_semaphore() }
 {
     assert( vkn::get_headless() == false );
+    assert( !frames.empty() );
+
+    for ( FrameContext& frame : frames )
+    {
+        frame.cmd_pool = vkn::create_command_pool( VK_COMMAND_POOL_CREATE_TRANSIENT_BIT );
+        frame.cmd_buff = vkn::allocate_command_buffer( frame.cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY );
+        frame.image_acquired_semaphore = vkn::create_semaphore();
+    }
+
+    render_finished_semaphores.resize( vkn::get_swapchain_images().size() );
+    for ( VkSemaphore& semaphore : render_finished_semaphores )
+        semaphore = vkn::create_semaphore();
+}
+
+WindowedApp::~WindowedApp()
+{
+    for ( FrameContext& frame : frames )
+    {
+        vkn::destroy_semaphore( frame.image_acquired_semaphore );
+        vkn::destroy_command_pool( frame.cmd_pool );
+    }
+
+    for ( const VkSemaphore semaphore : render_finished_semaphores )
+        vkn::destroy_semaphore( semaphore );
+
+    vkn::destroy_semaphore( timeline );
+}
+
+void WindowedApp::retire( const uint32_t frame_index )
+{
+    FrameContext& frame = frames[frame_index];
+
+    if ( !frame.pending )
+        return;
+
+    vkn::wait_semaphore( timeline, frame.timeline_value );
+
+    complete_frame( frame_index );
+    frame.transient_buffers.clear();
+    frame.pending = false;
+}
+
+void WindowedApp::add_transient_buffer( std::unique_ptr<const Buffer> buffer )
+{
+    frames[active_resource_index].transient_buffers.push_back( std::move( buffer ) );
 }
 
 void WindowedApp::run()
 {
-    assert( present_queue != VK_NULL_HANDLE );
+    assert( queue != VK_NULL_HANDLE );
+
+    vkn::profiler_init( get_frames_in_flight(), queue_family_index );
+
+    const VkCommandBufferBeginInfo cmd_buff_begin_info {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = nullptr,
+        .flags = reuse_command_buffers ? VkCommandBufferUsageFlags { 0x0 } : VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr,
+    };
+
+    for ( FrameContext& frame : frames )
+        frame.recorded = false;
 
     while ( !glfwWindowShouldClose( glfw_window ) )
     {
         glfwPollEvents();
 
-        const uint32_t active_swapchain_image_index = vkn::acquire_next_image( UINT64_MAX, VK_NULL_HANDLE, image_acquire_fences[active_resource_index] );
-        vkn::wait_for_fence( image_acquire_fences[active_resource_index], UINT64_MAX );
-        vkn::reset_fence( image_acquire_fences[active_resource_index] );        
+        FrameContext& frame = frames[active_resource_index];
+
+        // Only block when we are a full ring of frames ahead of the GPU
+        retire( active_resource_index );
+
+        const bool resubmit = reuse_command_buffers && frame.recorded;
+        vkn::profiler_begin_frame( active_resource_index, resubmit );
+
+        const uint32_t active_swapchain_image_index = vkn::acquire_next_image( UINT64_MAX, frame.image_acquired_semaphore, VK_NULL_HANDLE );
+
+        if ( !resubmit )
+        {
+            vkn::reset_command_pool( frame.cmd_pool );
+            VK_CHECK( vkBeginCommandBuffer( frame.cmd_buff, &cmd_buff_begin_info ) );
+
+            record_frame( frame.cmd_buff, active_resource_index );
+
+            VK_CHECK( vkEndCommandBuffer( frame.cmd_buff ) );
+            frame.recorded = true;
+        }
 
-        execute_frame();
+        frame.timeline_value = acquire_timeline_value();
+        frame.pending = true;
 
-        vkn::present( present_queue, active_swapchain_image_index );
+        const VkSemaphore render_finished_semaphore = render_finished_semaphores.at( active_swapchain_image_index );
 
-        vkn::device_wait_idle();
+        // Every command waits for the acquire, a later stage would let the batch run before the image is released
+        // by the presentation engine
+        vkn::queue_submit( queue, 1, &frame.cmd_buff,
+            { { .semaphore = frame.image_acquired_semaphore, .stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT } },
+            { { .semaphore = render_finished_semaphore }, { .semaphore = timeline, .value = frame.timeline_value } } );
+
+        submitted_frame( active_resource_index, frame.timeline_value );
+
+        vkn::present( queue, active_swapchain_image_index, 1, &render_finished_semaphore );
+
+        active_resource_index = ( active_resource_index + 1 ) % get_frames_in_flight();
     }
-}
 
-WindowedApp::~WindowedApp()
-{
-    for ( uint32_t i = 0; i < resource_count; i++ )
+    // Drain in submission order so complete_frame sees frames in order
+    for ( uint32_t i = 0; i < get_frames_in_flight(); i++ )
     {
-        vkn::destroy_fence( image_acquire_fences[i] );
+        retire( ( active_resource_index + i ) % get_frames_in_flight() );
     }
-}
\ No newline at end of file
+
+    // The drained submissions' timestamps would otherwise only be read when their slots are begun again
+    vkn::profiler_collect_all();
+
+    vkn::profiler_log_stats();
+}
@@ -4,28 +4,72 @@
 #include "BaseApp.hpp"
 
 #include <vulkan/vulkan.h>
+#include <memory>
 #include <vector>
 #include <string_view>
 
 class GLFWwindow;
+struct Buffer;
 
+// Windowed run loop with frames_in_flight frame contexts. Frame N+1 is recorded while frame N executes, the CPU only
+// blocks when it is a full ring of frames ahead of the GPU.
 struct WindowedApp : public BaseApp
 {
 private:
-    const uint32_t resource_count { 0 };
-    const std::vector<VkFence> image_acquire_fences;
+    struct FrameContext
+    {
+        VkCommandPool cmd_pool { VK_NULL_HANDLE };
+        VkCommandBuffer cmd_buff { VK_NULL_HANDLE };
+        VkSemaphore image_acquired_semaphore { VK_NULL_HANDLE };  // signaled by acquire, waited by the frame's submission
+        uint64_t timeline_value { 0 };                           // in flight until the timeline reaches this value
+        bool pending { false };                                  // submitted but complete_frame() not called yet
+        bool recorded { false };                                 // cmd_buff holds commands that may be resubmitted
+        std::vector<std::unique_ptr<const Buffer>> transient_buffers;
+    };
+
     GLFWwindow* const glfw_window { nullptr };
+    std::vector<FrameContext> frames;
+    // Per swapchain image: signaled by the submission, waited by the image's present. Only reused once the image is
+    // acquired again, which a frame context's timeline alone does not guarantee.
+    std::vector<VkSemaphore> render_finished_semaphores;
     uint32_t active_resource_index { 0 };
-    VkQueue present_queue { VK_NULL_HANDLE };
+    VkQueue queue { VK_NULL_HANDLE };
+    uint32_t queue_family_index { VK_QUEUE_FAMILY_IGNORED };
+    bool reuse_command_buffers { false };
+
+    // Every submission of the app signals the next value, the host only ever waits on the value it depends on
+    const VkSemaphore timeline { VK_NULL_HANDLE };
+    uint64_t timeline_value { 0 };
+
+    void retire( const uint32_t frame_index );
 protected:
-    void set_present_queue( const VkQueue queue ) { present_queue = queue; }
+    // Queue the frames are submitted and presented on
+    void set_queue( const VkQueue _queue, const uint32_t _queue_family_index ) { queue = _queue; queue_family_index = _queue_family_index; }
+    uint32_t get_frames_in_flight() const { return static_cast<uint32_t>( frames.size() ); }
+
+    // Records every frame context once and resubmits it unchanged, for apps whose frames never change
+    void set_reuse_command_buffers( const bool reuse ) { reuse_command_buffers = reuse; }
+
+    VkSemaphore get_timeline() const { return timeline; }
+    uint64_t acquire_timeline_value() { return ++timeline_value; }
+
+    // Keeps the buffer alive until the GPU is done with the frame currently being recorded
+    void add_transient_buffer( std::unique_ptr<const Buffer> buffer );
     void run();
 
-    virtual void execute_frame() = 0;
+    // Records one frame into a command buffer owned by the frame context. The context's previous frame has been retired.
+    // Only called for a context's first frame when command buffers are reused.
+    virtual void record_frame( const VkCommandBuffer cmd_buff, const uint32_t frame_index ) = 0;
+
+    // Called right after every submission of the context, the timeline reaches timeline_value once it has completed
+    virtual void submitted_frame( const uint32_t frame_index, const uint64_t timeline_value ) {}
+
+    // Called once the GPU has finished the frame previously recorded for the context.
+    virtual void complete_frame( const uint32_t frame_index ) = 0;
 public:
     WindowedApp( const std::string_view config_file_path );
     ~WindowedApp();
 };
 
 
-#endif // Windowed_APP_HPP
\ No newline at end of file
+#endif // Windowed_APP_HPP
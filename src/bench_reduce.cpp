@@ -0,0 +1,12 @@
+#include "BenchReduceApp.hpp"
+
+#include <string_view>
+
+int main( int argc, char** argv )
+{
+    const std::string_view config_file_path = ( argc > 1 ) ? argv[1] : "data/json/bench_info.json";
+
+    BenchReduceApp app( config_file_path );
+
+    return 0;
+}
@@ -1,8 +1,40 @@
 #include "App.hpp"
+#include "ComputeApp.hpp"
+#include "AutotuneApp.hpp"
+#include "HostApp.hpp"
+#include "HybridApp.hpp"
+#include "ShardedApp.hpp"
 
-int main()
+#include <string_view>
+
+int main( int argc, char** argv )
 {
-    App app( "/home/mica/Desktop/Vulkan/compute/data/json/vulkan_info.json" );
+    const std::string_view config_file_path = ( argc > 1 ) ? argv[1] : "/home/mica/Desktop/Vulkan/compute/data/json/vulkan_info.json";
+
+    if ( BaseApp::has_config_block( config_file_path, "autotune" ) )
+    {
+        AutotuneApp app( config_file_path );
+    }
+    else if ( BaseApp::is_multi_device_config( config_file_path ) )
+    {
+        ShardedApp app( config_file_path );
+    }
+    else if ( BaseApp::has_config_block( config_file_path, "hybrid" ) )
+    {
+        HybridApp app( config_file_path );
+    }
+    else if ( BaseApp::is_headless_config( config_file_path ) && HostApp::is_preferred( config_file_path ) )
+    {
+        HostApp app( config_file_path );
+    }
+    else if ( BaseApp::is_headless_config( config_file_path ) )
+    {
+        ComputeApp app( config_file_path );
+    }
+    else
+    {
+        App app( config_file_path );
+    }
 
     return 0;
-}
\ No newline at end of file
+}
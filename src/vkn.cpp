@@ -1,23 +1,53 @@
 #include "vkn.hpp"
 #include "vulkan_init.hpp"
+#include "vkn_allocator.hpp"
+#include "vkn_profiler.hpp"
+#include "vkn_shader.hpp"
+#include "vkn_submit.hpp"
+#include "vkn_tuning.hpp"
 #include "defines.hpp"
 
 #include <GLFW/glfw3.h>
 
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
 namespace vkn
 {
 
 namespace
 {
 
-static VulkanCoreInfo core;
+struct DeviceContext
+{
+    VulkanCoreInfo core;
+    VkPipelineCache pipeline_cache { VK_NULL_HANDLE };
+    VkPipelineLayout push_constant_pipeline_layout { VK_NULL_HANDLE };
+};
+
+// Every vkn call operates on the current device, core and pipeline_cache point into its context
+static std::vector<DeviceContext> device_contexts;
+static uint32_t current_device_index { 0 };
+static VulkanCoreInfo* core { nullptr };
+static VkPipelineCache* pipeline_cache { nullptr };
+
+static void make_current( const uint32_t device_index )
+{
+    current_device_index = device_index;
+    core = &device_contexts.at( device_index ).core;
+    pipeline_cache = &device_contexts[device_index].pipeline_cache;
+}
 
 static uint32_t get_memory_type_idx(const uint32_t memory_type_indices, const VkMemoryPropertyFlags memory_property_flags)
 {
    	// Iterate over all memory types available for the device used in this example
-	for (uint32_t i = 0; i < core.physical_device_memory_properties.memoryTypeCount; i++)
+	for (uint32_t i = 0; i < core->physical_device_memory_properties.memoryTypeCount; i++)
 	{
-		if (memory_type_indices & (1 << i) && (core.physical_device_memory_properties.memoryTypes[i].propertyFlags & memory_property_flags) == memory_property_flags)
+		if (memory_type_indices & (1 << i) && (core->physical_device_memory_properties.memoryTypes[i].propertyFlags & memory_property_flags) == memory_property_flags)
 		{
 			return i;
 		}
@@ -27,6 +57,83 @@ static uint32_t get_memory_type_idx(const uint32_t memory_type_indices, const Vk
     return 0; 
 }
 
+// Cache data from another device or driver is useless (and may be rejected), the header tells us where it came from
+static bool is_pipeline_cache_compatible( const std::vector<uint8_t>& data )
+{
+    VkPipelineCacheHeaderVersionOne header {};
+    if ( data.size() < sizeof( header ) )
+        return false;
+
+    memcpy( &header, data.data(), sizeof( header ) );
+
+    return header.headerSize >= sizeof( header )
+        && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && header.vendorID == core->physical_device_properties.vendorID
+        && header.deviceID == core->physical_device_properties.deviceID
+        && memcmp( header.pipelineCacheUUID, core->physical_device_properties.pipelineCacheUUID, VK_UUID_SIZE ) == 0;
+}
+
+static std::vector<uint8_t> read_pipeline_cache_file( const std::string& file_path )
+{
+    std::vector<uint8_t> data;
+
+    FILE* f = fopen( file_path.c_str(), "rb" );
+    if ( f == nullptr )
+        return data;
+
+    fseek( f, 0, SEEK_END );
+    const long nbytes_file_size = ftell( f );
+    rewind( f );
+
+    if ( nbytes_file_size > 0 )
+    {
+        data.resize( static_cast<size_t>( nbytes_file_size ) );
+        if ( fread( data.data(), data.size(), 1, f ) != 1 )
+            data.clear();
+    }
+
+    fclose( f );
+    return data;
+}
+
+static void init_pipeline_cache()
+{
+    std::vector<uint8_t> initial_data;
+
+    if ( !core->pipeline_cache_path.empty() )
+    {
+        initial_data = read_pipeline_cache_file( core->pipeline_cache_path );
+
+        if ( !initial_data.empty() && !is_pipeline_cache_compatible( initial_data ) )
+        {
+            LOG( "Pipeline cache %s was created by another device or driver, starting empty\n", core->pipeline_cache_path.c_str() );
+            initial_data.clear();
+        }
+    }
+
+    const VkPipelineCacheCreateInfo create_info {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0x0,
+        .initialDataSize = initial_data.size(),
+        .pInitialData = initial_data.empty() ? nullptr : initial_data.data(),
+    };
+
+    VK_CHECK( vkCreatePipelineCache( core->device, &create_info, nullptr, pipeline_cache ) );
+
+    if ( !initial_data.empty() )
+        LOG( "Loaded pipeline cache %s (%zu bytes)\n", core->pipeline_cache_path.c_str(), initial_data.size() );
+}
+
+static void destroy_pipeline_cache()
+{
+    save_pipeline_cache();
+
+    vkDestroyPipelineCache( core->device, *pipeline_cache, nullptr );
+    *pipeline_cache = VK_NULL_HANDLE;
+}
+
+
 }
 
 uint32_t VkResource::id_counter = 0;
@@ -34,39 +141,39 @@ uint32_t VkResource::id_counter = 0;
 
 bool get_headless()
 {
-    return !core.swapchain_info.has_value();
+    return !core->swapchain_info.has_value();
 }
 
 GLFWwindow* get_glfw_window()
 {
-    assert( core.swapchain_info.has_value() );
-    return core.swapchain_info->glfw_window;
+    assert( core->swapchain_info.has_value() );
+    return core->swapchain_info->glfw_window;
 }
 
 
 uint32_t get_frames_in_flight()
 {
-    assert( core.swapchain_info.has_value() );
-    return core.swapchain_info->frames_in_flight;
+    assert( core->swapchain_info.has_value() );
+    return core->swapchain_info->frames_in_flight;
 }
 
 
 std::vector<VkImage> get_swapchain_images()
 {
-    assert( core.swapchain_info.has_value() );
-    return core.swapchain_info->swapchain_images;
+    assert( core->swapchain_info.has_value() );
+    return core->swapchain_info->swapchain_images;
 }
 
 std::vector<VkImageView> get_swapchain_image_views()
 {
-    assert( core.swapchain_info.has_value() );
-    return core.swapchain_info->swapchain_image_views;
+    assert( core->swapchain_info.has_value() );
+    return core->swapchain_info->swapchain_image_views;
 }
 
 
 void present( const VkQueue queue, const uint32_t swapchain_image_index, const uint32_t wait_semaphore_count, const VkSemaphore* const wait_semaphores, void* p_next )
 {
-    assert( core.swapchain_info.has_value() );
+    assert( core->swapchain_info.has_value() );
 
     const VkPresentInfoKHR present_info {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -74,7 +181,7 @@ void present( const VkQueue queue, const uint32_t swapchain_image_index, const u
         .waitSemaphoreCount = wait_semaphore_count,
         .pWaitSemaphores = wait_semaphores,
         .swapchainCount = 1,
-        .pSwapchains = &core.swapchain_info->swapchain,
+        .pSwapchains = &core->swapchain_info->swapchain,
         .pImageIndices = &swapchain_image_index,
         .pResults = nullptr,
     };
@@ -85,55 +192,205 @@ void present( const VkQueue queue, const uint32_t swapchain_image_index, const u
 
 void init( const std::string_view json_path )
 {
-    core = vulkan_init( json_path );
+    const std::vector<VulkanCoreInfo> core_infos = vulkan_init( json_path );
+
+    device_contexts.clear();
+    device_contexts.resize( core_infos.size() );
+
+    // Every device gets its own allocator, caches and tuning, in reverse so device 0 ends up current
+    for ( uint32_t i = static_cast<uint32_t>( core_infos.size() ); i-- > 0; )
+    {
+        device_contexts[i].core = core_infos[i];
+        make_current( i );
+
+        init_allocator();
+        init_pipeline_cache();
+        init_shader_cache( core->shader_search_paths );
+        init_tuning( core->tuning_path );
+        init_submit_scheduler();
+
+        const VkPushConstantRange push_constant_range {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = push_constant_size,
+        };
+
+        const VkPipelineLayoutCreateInfo pipeline_layout_create_info {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0x0,
+            .setLayoutCount = 0,
+            .pSetLayouts = nullptr,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &push_constant_range,
+        };
+
+        device_contexts[i].push_constant_pipeline_layout = create_pipeline_layout( pipeline_layout_create_info );
+    }
+}
+
+bool is_device_available()
+{
+    const VkApplicationInfo app_info {
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .apiVersion = VK_API_VERSION_1_3,
+    };
+
+    const VkInstanceCreateInfo create_info {
+        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pApplicationInfo = &app_info,
+    };
+
+    VkInstance instance = VK_NULL_HANDLE;
+    if ( vkCreateInstance( &create_info, nullptr, &instance ) != VK_SUCCESS )
+        return false;
+
+    uint32_t physical_device_count = 0;
+    vkEnumeratePhysicalDevices( instance, &physical_device_count, nullptr );
+    std::vector<VkPhysicalDevice> physical_devices( physical_device_count );
+    vkEnumeratePhysicalDevices( instance, &physical_device_count, physical_devices.data() );
+
+    bool available = false;
+    for ( const VkPhysicalDevice physical_device : physical_devices )
+    {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties( physical_device, &props );
+        if ( props.apiVersion < VK_API_VERSION_1_3 )
+            continue;
+
+        uint32_t queue_family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties( physical_device, &queue_family_count, nullptr );
+        std::vector<VkQueueFamilyProperties> queue_family_props( queue_family_count );
+        vkGetPhysicalDeviceQueueFamilyProperties( physical_device, &queue_family_count, queue_family_props.data() );
+
+        available |= std::any_of( queue_family_props.begin(), queue_family_props.end(),
+            []( const VkQueueFamilyProperties& props ) { return ( props.queueFlags & VK_QUEUE_COMPUTE_BIT ) != 0; } );
+    }
+
+    vkDestroyInstance( instance, nullptr );
+    return available;
 }
 
 void destroy()
 {
-    if ( core.swapchain_info.has_value() )
+    profiler_destroy();
+
+    for ( uint32_t i = 0; i < device_contexts.size(); i++ )
     {
-        glfwDestroyWindow( core.swapchain_info->glfw_window );
-        glfwTerminate();
+        make_current( i );
+
+        destroy_pipeline_layout( device_contexts[i].push_constant_pipeline_layout );
+        destroy_submit_scheduler();
+        destroy_shader_cache();
+        destroy_pipeline_cache();
+        destroy_allocator();
+
+        if ( core->swapchain_info.has_value() )
+        {
+            glfwDestroyWindow( core->swapchain_info->glfw_window );
+            glfwTerminate();
+
+            for ( uint32_t j = 0; j < core->swapchain_info->swapchain_image_views.size(); j++ )
+                vkDestroyImageView( core->device, core->swapchain_info->swapchain_image_views[j], nullptr );
 
-        for ( uint32_t i = 0; i < core.swapchain_info->swapchain_image_views.size(); i++ )
-            vkDestroyImageView( core.device, core.swapchain_info->swapchain_image_views[i], nullptr );
+            vkDestroySwapchainKHR( core->device, core->swapchain_info->swapchain, nullptr );
+            vkDestroySurfaceKHR( core->instance, core->swapchain_info->surface, nullptr );
+        }
 
-        vkDestroySwapchainKHR( core.device, core.swapchain_info->swapchain, nullptr );
-        vkDestroySurfaceKHR( core.instance, core.swapchain_info->surface, nullptr );
+        vkDestroyDevice( core->device, nullptr );
     }
 
-    vkDestroyDevice( core.device, nullptr );
-    vkDestroyInstance( core.instance, nullptr );
+    vkDestroyInstance( device_contexts.at( 0 ).core.instance, nullptr );
+
+    device_contexts.clear();
+    core = nullptr;
+    pipeline_cache = nullptr;
+}
+
+uint32_t get_device_count()
+{
+    return static_cast<uint32_t>( device_contexts.size() );
+}
+
+uint32_t get_current_device_index()
+{
+    return current_device_index;
+}
+
+void set_current_device( const uint32_t device_index )
+{
+    ASSERT( device_index < device_contexts.size(), "Device index %u out of range!\n", device_index );
+    make_current( device_index );
 }
 
 
 void device_wait_idle()
 {
-    VK_CHECK( vkDeviceWaitIdle( core.device ) );
+    VK_CHECK( vkDeviceWaitIdle( core->device ) );
 }
 
 uint32_t acquire_next_image( const uint64_t timeout, const VkSemaphore semaphore, const VkFence fence )
 {
-    assert( core.swapchain_info.has_value() );
+    assert( core->swapchain_info.has_value() );
     uint32_t image_index = 0;
-    VK_CHECK( vkAcquireNextImageKHR( core.device, core.swapchain_info->swapchain, timeout, semaphore, fence, &image_index ) );
+    VK_CHECK( vkAcquireNextImageKHR( core->device, core->swapchain_info->swapchain, timeout, semaphore, fence, &image_index ) );
     return image_index;
 }
 
+const VkPhysicalDeviceProperties& get_physical_device_properties()
+{
+    return core->physical_device_properties;
+}
+
+const VkPhysicalDeviceSubgroupProperties& get_physical_device_subgroup_properties()
+{
+    return core->physical_device_subgroup_properties;
+}
+
+const VkPhysicalDeviceIDProperties& get_physical_device_id_properties()
+{
+    return core->physical_device_id_properties;
+}
+
+const VkPhysicalDeviceMaintenance4Properties& get_physical_device_maintenance4_properties()
+{
+    return core->physical_device_maintenance4_properties;
+}
+
+VkPipelineLayout get_push_constant_pipeline_layout()
+{
+    return device_contexts.at( current_device_index ).push_constant_pipeline_layout;
+}
+
 VkQueue get_queue( const uint32_t index )
 {
-    return core.queues.at( index );
+    return core->queues.at( index );
+}
+
+uint32_t get_queue_count()
+{
+    return static_cast<uint32_t>( core->queues.size() );
 }
 
 uint32_t get_queue_family_index()
 {
-    return core.queue_family_index;
+    return core->queue_family_index;
+}
+
+uint32_t get_queue_family_index( const uint32_t queue_index )
+{
+    return core->queue_family_indices.at( queue_index );
+}
+
+const VkQueueFamilyProperties& get_queue_family_properties( const uint32_t queue_family_index )
+{
+    return core->queue_family_properties.at( queue_family_index );
 }
 
 VkBuffer create_buffer( const VkBufferCreateInfo& create_info )
 {
     VkBuffer buffer { VK_NULL_HANDLE };
-    VK_CHECK( vkCreateBuffer( core.device, &create_info, nullptr, &buffer ) );
+    VK_CHECK( vkCreateBuffer( core->device, &create_info, nullptr, &buffer ) );
     return buffer;
 }
 
@@ -151,20 +408,31 @@ VkBuffer create_buffer( const VkBufferUsageFlags buffer_usage, const VkDeviceSiz
     };
 
     VkBuffer buffer { VK_NULL_HANDLE };
-    VK_CHECK( vkCreateBuffer( core.device, &create_info, nullptr, &buffer ) );
+    VK_CHECK( vkCreateBuffer( core->device, &create_info, nullptr, &buffer ) );
     return buffer;
 }
 
 void destroy_buffer( const VkBuffer buffer )
 {
-    vkDestroyBuffer( core.device, buffer, nullptr );
+    vkDestroyBuffer( core->device, buffer, nullptr );
+}
+
+VkDeviceAddress get_device_address( const VkBuffer buffer )
+{
+    const VkBufferDeviceAddressInfo address_info {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+        .pNext = nullptr,
+        .buffer = buffer,
+    };
+
+    return vkGetBufferDeviceAddress( core->device, &address_info );
 }
 
 
 VkDeviceMemory alloc_buffer_memory( const VkBuffer buffer, const VkMemoryPropertyFlags mem_props )
 {
     VkMemoryRequirements mem_reqs;
-    vkGetBufferMemoryRequirements( core.device, buffer, &mem_reqs );
+    vkGetBufferMemoryRequirements( core->device, buffer, &mem_reqs );
 
     const VkMemoryAllocateInfo mem_alloc_info {
         .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
@@ -174,89 +442,261 @@ VkDeviceMemory alloc_buffer_memory( const VkBuffer buffer, const VkMemoryPropert
     };
 
     VkDeviceMemory memory { VK_NULL_HANDLE };
-    VK_CHECK( vkAllocateMemory( core.device, &mem_alloc_info, nullptr, &memory ) );
+    VK_CHECK( vkAllocateMemory( core->device, &mem_alloc_info, nullptr, &memory ) );
     return memory;
 }
 
-void bind_buffer_memory( const VkBuffer buffer, const VkDeviceMemory memory, const VkDeviceSize offset )
+VkDeviceMemory alloc_memory( const VkDeviceSize size, const uint32_t memory_type_index, const void* const p_next )
 {
-    VK_CHECK( vkBindBufferMemory( core.device, buffer, memory, offset ) );
+    const VkMemoryAllocateInfo mem_alloc_info {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = p_next,
+        .allocationSize = size,
+        .memoryTypeIndex = memory_type_index
+    };
+
+    VkDeviceMemory memory { VK_NULL_HANDLE };
+    VK_CHECK( vkAllocateMemory( core->device, &mem_alloc_info, nullptr, &memory ) );
+    return memory;
 }
 
-void map_memory( const VkDeviceMemory memory, const uint64_t offset, const uint64_t size, void** data )
+VkMemoryRequirements get_buffer_memory_requirements( const VkBuffer buffer )
 {
-    VK_CHECK( vkMapMemory( core.device, memory, offset, size, 0x0, data ) );
+    VkMemoryRequirements mem_reqs;
+    vkGetBufferMemoryRequirements( core->device, buffer, &mem_reqs );
+    return mem_reqs;
 }
 
-void unmap_memory( const VkDeviceMemory memory )
+uint32_t get_memory_type_index( const uint32_t memory_type_bits, const VkMemoryPropertyFlags mem_props )
 {
-    vkUnmapMemory( core.device, memory );
+    return get_memory_type_idx( memory_type_bits, mem_props );
 }
 
-void free_memory( const VkDeviceMemory memory )
+const VkPhysicalDeviceMemoryProperties& get_physical_device_memory_properties()
+{
+    return core->physical_device_memory_properties;
+}
+
+VkDeviceSize get_memory_heap_budget( const uint32_t heap_index )
+{
+    assert( heap_index < core->physical_device_memory_properties.memoryHeapCount );
+
+    uint32_t extension_count = 0;
+    VK_CHECK( vkEnumerateDeviceExtensionProperties( core->physical_device, nullptr, &extension_count, nullptr ) );
+    std::vector<VkExtensionProperties> extensions( extension_count );
+    VK_CHECK( vkEnumerateDeviceExtensionProperties( core->physical_device, nullptr, &extension_count, extensions.data() ) );
+
+    const bool budget_supported = std::any_of( extensions.begin(), extensions.end(),
+        []( const VkExtensionProperties& extension ) { return strcmp( extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME ) == 0; } );
+    if ( !budget_supported )
+        return core->physical_device_memory_properties.memoryHeaps[heap_index].size;
+
+    // Queried fresh every call, the budget changes with what this and other processes allocated
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_props { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT };
+    VkPhysicalDeviceMemoryProperties2 mem_props2 { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2, .pNext = &budget_props };
+    vkGetPhysicalDeviceMemoryProperties2( core->physical_device, &mem_props2 );
+
+    const VkDeviceSize budget = budget_props.heapBudget[heap_index];
+    const VkDeviceSize usage = budget_props.heapUsage[heap_index];
+    return ( budget > usage ) ? budget - usage : 0;
+}
+
+void bind_buffer_memory( const VkBuffer buffer, const VkDeviceMemory memory, const VkDeviceSize offset )
 {
-    vkFreeMemory( core.device, memory, nullptr );
+    VK_CHECK( vkBindBufferMemory( core->device, buffer, memory, offset ) );
 }
 
+void map_memory( const VkDeviceMemory memory, const uint64_t offset, const uint64_t size, void** data )
+{
+    VK_CHECK( vkMapMemory( core->device, memory, offset, size, 0x0, data ) );
+}
 
-VkShaderModule create_shader_module( const std::string_view file_path )
+void unmap_memory( const VkDeviceMemory memory )
 {
-    static const std::string prefix = "/home/mica/Desktop/Vulkan/compute/data/spirv/";
-    static const std::string postfix = ".spv";
+    vkUnmapMemory( core->device, memory );
+}
 
-    std::string complete_filepath = prefix + std::string( file_path ) + postfix;
+void invalidate_mapped_memory( const VkDeviceMemory memory, const VkDeviceSize offset, const VkDeviceSize size )
+{
+    const VkMappedMemoryRange range {
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .pNext = nullptr,
+        .memory = memory,
+        .offset = offset,
+        .size = size,
+    };
 
-    FILE* f = fopen( complete_filepath.c_str(), "r" );
-    ASSERT( f != 0, "Failed to open file %s!\n", complete_filepath.c_str() );
+    VK_CHECK( vkInvalidateMappedMemoryRanges( core->device, 1, &range ) );
+}
 
-    fseek( f, 0, SEEK_END );
-    const size_t nbytes_file_size = (size_t)ftell( f );
-    rewind( f );
+void free_memory( const VkDeviceMemory memory )
+{
+    vkFreeMemory( core->device, memory, nullptr );
+}
 
-    uint32_t* buffer = (uint32_t*)malloc( nbytes_file_size );
-    fread( buffer, nbytes_file_size, 1, f );
-    fclose( f );
 
-    VkShaderModuleCreateInfo create_info {
+VkShaderModule create_shader_module( const size_t code_size, const uint32_t* const code )
+{
+    const VkShaderModuleCreateInfo create_info {
         .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .codeSize = nbytes_file_size,
-        .pCode = buffer,
+        .pNext = nullptr,
+        .flags = 0x0,
+        .codeSize = code_size,
+        .pCode = code,
     };
 
     VkShaderModule shader_module = VK_NULL_HANDLE;
-    VK_CHECK( vkCreateShaderModule( core.device, &create_info, NULL, &shader_module ) );
-
-    free( buffer );
+    VK_CHECK( vkCreateShaderModule( core->device, &create_info, nullptr, &shader_module ) );
     return shader_module;
 }
 
 void destroy_shader_module( const VkShaderModule module )
 {
-    vkDestroyShaderModule( core.device, module, nullptr );
+    vkDestroyShaderModule( core->device, module, nullptr );
 }
 
 VkPipelineLayout create_pipeline_layout( const VkPipelineLayoutCreateInfo& create_info )
 {
     VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
-    VK_CHECK( vkCreatePipelineLayout( core.device, &create_info, nullptr, &pipeline_layout ) );
+    VK_CHECK( vkCreatePipelineLayout( core->device, &create_info, nullptr, &pipeline_layout ) );
     return pipeline_layout;
 }
 
 void destroy_pipeline_layout( const VkPipelineLayout layout )
 {
-    vkDestroyPipelineLayout( core.device, layout, nullptr );
+    vkDestroyPipelineLayout( core->device, layout, nullptr );
 }
 
 VkPipeline create_compute_pipeline( const VkComputePipelineCreateInfo& create_info )
 {
     VkPipeline pipeline = VK_NULL_HANDLE;
-    VK_CHECK( vkCreateComputePipelines( core.device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline ) );
+    VK_CHECK( vkCreateComputePipelines( core->device, *pipeline_cache, 1, &create_info, nullptr, &pipeline ) );
     return pipeline;
 }
 
+VkPipeline create_compute_pipeline( const VkShaderModule module, const VkPipelineLayout layout, const ComputeSpecialization& specialization )
+{
+    ASSERT( is_compute_specialization_supported( specialization ), "Compute specialization (%u, %u, %u, %u) exceeds the device limits!\n",
+        specialization.local_size_x, specialization.elements_per_thread, specialization.unroll, specialization.vectorized );
+
+    const std::array<VkSpecializationMapEntry, 4> map_entries {{
+        { .constantID = 0, .offset = offsetof( ComputeSpecialization, local_size_x ), .size = sizeof( uint32_t ) },
+        { .constantID = 1, .offset = offsetof( ComputeSpecialization, elements_per_thread ), .size = sizeof( uint32_t ) },
+        { .constantID = 2, .offset = offsetof( ComputeSpecialization, unroll ), .size = sizeof( uint32_t ) },
+        { .constantID = 3, .offset = offsetof( ComputeSpecialization, vectorized ), .size = sizeof( VkBool32 ) },
+    }};
+
+    const VkSpecializationInfo specialization_info {
+        .mapEntryCount = static_cast<uint32_t>( map_entries.size() ),
+        .pMapEntries = map_entries.data(),
+        .dataSize = sizeof( ComputeSpecialization ),
+        .pData = &specialization,
+    };
+
+    const VkComputePipelineCreateInfo create_info {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0x0,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0x0,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = module,
+            .pName = "main",
+            .pSpecializationInfo = &specialization_info },
+        .layout = layout,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = 0,
+    };
+
+    return create_compute_pipeline( create_info );
+}
+
+ComputeSpecialization select_compute_specialization( const std::string_view kernel_name )
+{
+    if ( const std::optional<ComputeSpecialization> tuned = find_tuned_compute_specialization( kernel_name ); tuned.has_value() )
+    {
+        if ( is_compute_specialization_supported( tuned.value() ) )
+            return tuned.value();
+
+        LOG( "WARNING - Tuned specialization of %.*s is not supported, falling back to defaults\n", static_cast<int>( kernel_name.size() ), kernel_name.data() );
+    }
+
+    const VkPhysicalDeviceLimits& limits = core->physical_device_properties.limits;
+    const uint32_t subgroup_size = std::max( 1u, core->physical_device_subgroup_properties.subgroupSize );
+    const uint32_t max_local_size = std::min( limits.maxComputeWorkGroupSize[0], limits.maxComputeWorkGroupInvocations );
+
+    // 256 invocations keeps enough subgroups per workgroup on 32 and 64 wide hardware, rounded to whole subgroups
+    uint32_t local_size_x = std::min( 256u, max_local_size );
+    local_size_x = std::max( subgroup_size, ( local_size_x / subgroup_size ) * subgroup_size );
+
+    // CPU implementations (e.g. lavapipe) run few, wide invocations, give each one more loads to amortise the loop
+    const bool is_cpu = core->physical_device_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+    const uint32_t elements_per_thread = is_cpu ? 16 : 4;
+
+    const ComputeSpecialization specialization {
+        .local_size_x = local_size_x,
+        .elements_per_thread = elements_per_thread,
+        .unroll = std::min( elements_per_thread, 4u ),
+        .vectorized = VK_TRUE,
+    };
+
+    ASSERT( is_compute_specialization_supported( specialization ), "No supported compute specialization on this device!\n" );
+    return specialization;
+}
+
+bool is_compute_specialization_supported( const ComputeSpecialization& specialization )
+{
+    const VkPhysicalDeviceLimits& limits = core->physical_device_properties.limits;
+    const uint32_t subgroup_size = std::max( 1u, core->physical_device_subgroup_properties.subgroupSize );
+
+    // Kernels keep one shared uint per invocation for their subgroup partials
+    return specialization.local_size_x > 0
+        && specialization.local_size_x <= limits.maxComputeWorkGroupSize[0]
+        && specialization.local_size_x <= limits.maxComputeWorkGroupInvocations
+        && ( specialization.local_size_x % subgroup_size ) == 0
+        && specialization.local_size_x * sizeof( uint32_t ) <= limits.maxComputeSharedMemorySize
+        && specialization.elements_per_thread > 0
+        && specialization.unroll > 0
+        && specialization.unroll <= specialization.elements_per_thread;
+}
+
+void save_pipeline_cache()
+{
+    if ( core->pipeline_cache_path.empty() || *pipeline_cache == VK_NULL_HANDLE )
+        return;
+
+    size_t data_size = 0;
+    VK_CHECK( vkGetPipelineCacheData( core->device, *pipeline_cache, &data_size, nullptr ) );
+
+    std::vector<uint8_t> data( data_size );
+    VK_CHECK( vkGetPipelineCacheData( core->device, *pipeline_cache, &data_size, data.data() ) );
+    data.resize( data_size );
+
+    // Write a temporary file and rename it over the old one, a crash mid-write never leaves a truncated cache behind
+    const std::string tmp_path = core->pipeline_cache_path + ".tmp";
+
+    FILE* f = fopen( tmp_path.c_str(), "wb" );
+    if ( f == nullptr )
+    {
+        LOG( "WARNING - Failed to open %s, pipeline cache not saved!\n", tmp_path.c_str() );
+        return;
+    }
+
+    const bool written = ( data.empty() || fwrite( data.data(), data.size(), 1, f ) == 1 ) && fflush( f ) == 0 && fsync( fileno( f ) ) == 0;
+    fclose( f );
+
+    if ( !written || rename( tmp_path.c_str(), core->pipeline_cache_path.c_str() ) != 0 )
+    {
+        LOG( "WARNING - Failed to write pipeline cache %s!\n", core->pipeline_cache_path.c_str() );
+        remove( tmp_path.c_str() );
+    }
+}
+
 void destroy_pipeline( const VkPipeline pipeline )
 {
-    vkDestroyPipeline( core.device, pipeline, nullptr );
+    vkDestroyPipeline( core->device, pipeline, nullptr );
 }
 
 VkDescriptorSetLayout create_desc_set_layout( const uint32_t binding_count, const VkDescriptorSetLayoutBinding* const bindings, const VkDescriptorSetLayoutCreateFlags flags, const void* const p_next )
@@ -270,13 +710,13 @@ VkDescriptorSetLayout create_desc_set_layout( const uint32_t binding_count, cons
     };
 
     VkDescriptorSetLayout layout = VK_NULL_HANDLE;
-    VK_CHECK( vkCreateDescriptorSetLayout( core.device, &create_info, nullptr, &layout ) );
+    VK_CHECK( vkCreateDescriptorSetLayout( core->device, &create_info, nullptr, &layout ) );
     return layout;
 }
 
 void destroy_desc_set_layout( const VkDescriptorSetLayout layout )
 {
-    vkDestroyDescriptorSetLayout( core.device, layout, nullptr ); 
+    vkDestroyDescriptorSetLayout( core->device, layout, nullptr ); 
 }
 
 VkDescriptorPool create_desc_pool( const uint32_t max_sets, const uint32_t pool_size_count, const VkDescriptorPoolSize* const pool_sizes, const VkDescriptorPoolCreateFlags flags, const void* const p_next )
@@ -291,13 +731,13 @@ VkDescriptorPool create_desc_pool( const uint32_t max_sets, const uint32_t pool_
     };
 
     VkDescriptorPool pool = VK_NULL_HANDLE;
-    VK_CHECK( vkCreateDescriptorPool( core.device, &create_info, nullptr, &pool ) );
+    VK_CHECK( vkCreateDescriptorPool( core->device, &create_info, nullptr, &pool ) );
     return pool;
 }
 
 void destroy_desc_pool( const VkDescriptorPool pool )
 {
-    vkDestroyDescriptorPool( core.device, pool, nullptr );
+    vkDestroyDescriptorPool( core->device, pool, nullptr );
 }
 
 VkDescriptorSet alloc_desc_set( const VkDescriptorPool pool, const VkDescriptorSetLayout* const layout, const void* const p_next )
@@ -311,7 +751,7 @@ VkDescriptorSet alloc_desc_set( const VkDescriptorPool pool, const VkDescriptorS
     };
 
     VkDescriptorSet set = VK_NULL_HANDLE;
-    VK_CHECK( vkAllocateDescriptorSets( core.device, &alloc_info, &set ) );
+    VK_CHECK( vkAllocateDescriptorSets( core->device, &alloc_info, &set ) );
     return set;
 }
 
@@ -326,37 +766,42 @@ std::vector<VkDescriptorSet> alloc_desc_sets( const VkDescriptorPool pool, const
     };
 
     std::vector<VkDescriptorSet> sets( count, VK_NULL_HANDLE );
-    VK_CHECK( vkAllocateDescriptorSets( core.device, &alloc_info, sets.data() ) );
+    VK_CHECK( vkAllocateDescriptorSets( core->device, &alloc_info, sets.data() ) );
     return sets;
 }
 
 void write_desc_sets( const uint32_t write_count, const VkWriteDescriptorSet* write_desc_sets )
 {
-    vkUpdateDescriptorSets( core.device, write_count, write_desc_sets, 0, nullptr );
+    vkUpdateDescriptorSets( core->device, write_count, write_desc_sets, 0, nullptr );
 }
 
 VkCommandPool create_command_pool( const VkCommandPoolCreateFlags flags )
+{
+    return create_command_pool( flags, core->queue_family_index );
+}
+
+VkCommandPool create_command_pool( const VkCommandPoolCreateFlags flags, const uint32_t queue_family_index )
 {
     const VkCommandPoolCreateInfo create_info {
         .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
         .pNext = nullptr,
         .flags = flags,
-        .queueFamilyIndex = core.queue_family_index,
+        .queueFamilyIndex = queue_family_index,
     };
 
     VkCommandPool cmd_pool = VK_NULL_HANDLE;
-    VK_CHECK( vkCreateCommandPool( core.device, &create_info, nullptr, &cmd_pool ) );
+    VK_CHECK( vkCreateCommandPool( core->device, &create_info, nullptr, &cmd_pool ) );
     return cmd_pool;
 }
 
 void reset_command_pool( const VkCommandPool pool )
 {
-    VK_CHECK( vkResetCommandPool( core.device, pool, 0x0 ) );
+    VK_CHECK( vkResetCommandPool( core->device, pool, 0x0 ) );
 }
 
 void destroy_command_pool( const VkCommandPool pool )
 {
-    vkDestroyCommandPool( core.device, pool, nullptr );
+    vkDestroyCommandPool( core->device, pool, nullptr );
 }
 
 VkCommandBuffer allocate_command_buffer( const VkCommandPool cmd_pool, const VkCommandBufferLevel level )
@@ -370,10 +815,25 @@ VkCommandBuffer allocate_command_buffer( const VkCommandPool cmd_pool, const VkC
     };
 
     VkCommandBuffer cmd_buff = VK_NULL_HANDLE;
-    VK_CHECK( vkAllocateCommandBuffers( core.device, &alloc_info, &cmd_buff ) );
+    VK_CHECK( vkAllocateCommandBuffers( core->device, &alloc_info, &cmd_buff ) );
     return cmd_buff;
 }
 
+std::vector<VkCommandBuffer> allocate_command_buffers( const VkCommandPool cmd_pool, const VkCommandBufferLevel level, const uint32_t count )
+{
+    VkCommandBufferAllocateInfo alloc_info {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = nullptr,
+        .commandPool = cmd_pool,
+        .level = level,
+        .commandBufferCount = count,
+    };
+
+    std::vector<VkCommandBuffer> cmd_buffs( count, VK_NULL_HANDLE );
+    VK_CHECK( vkAllocateCommandBuffers( core->device, &alloc_info, cmd_buffs.data() ) );
+    return cmd_buffs;
+}
+
 
 VkFence create_fence( const VkFenceCreateFlags flags, const void* p_next )
 {
@@ -384,23 +844,376 @@ VkFence create_fence( const VkFenceCreateFlags flags, const void* p_next )
     }; 
 
     VkFence fence { VK_NULL_HANDLE };
-    VK_CHECK( vkCreateFence( core.device, &create_info, nullptr, &fence ) );
+    VK_CHECK( vkCreateFence( core->device, &create_info, nullptr, &fence ) );
     return fence;
 }
 
 void wait_for_fence( const VkFence fence, const uint64_t timeout )
 {
-    VK_CHECK( vkWaitForFences( core.device, 1, &fence, VK_TRUE, timeout ) );
+    VK_CHECK( vkWaitForFences( core->device, 1, &fence, VK_TRUE, timeout ) );
+}
+
+bool is_fence_signaled( const VkFence fence )
+{
+    const VkResult result = vkGetFenceStatus( core->device, fence );
+    assert( result == VK_SUCCESS || result == VK_NOT_READY );
+    return result == VK_SUCCESS;
 }
 
 void reset_fence( const VkFence fence )
 {
-    VK_CHECK( vkResetFences( core.device, 1, &fence ) );
+    VK_CHECK( vkResetFences( core->device, 1, &fence ) );
 }
 
 void destroy_fence( const VkFence fence )
 {
-    vkDestroyFence( core.device, fence, nullptr );
+    vkDestroyFence( core->device, fence, nullptr );
+}
+
+VkQueryPool create_query_pool( const VkQueryType type, const uint32_t query_count )
+{
+    const VkQueryPoolCreateInfo create_info {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0x0,
+        .queryType = type,
+        .queryCount = query_count,
+        .pipelineStatistics = 0x0,
+    };
+
+    VkQueryPool pool { VK_NULL_HANDLE };
+    VK_CHECK( vkCreateQueryPool( core->device, &create_info, nullptr, &pool ) );
+    return pool;
+}
+
+void destroy_query_pool( const VkQueryPool pool )
+{
+    vkDestroyQueryPool( core->device, pool, nullptr );
+}
+
+void reset_query_pool( const VkQueryPool pool, const uint32_t first_query, const uint32_t query_count )
+{
+    vkResetQueryPool( core->device, pool, first_query, query_count );
+}
+
+bool get_query_pool_results( const VkQueryPool pool, const uint32_t first_query, const uint32_t query_count, const size_t data_size, void* const data, const VkDeviceSize stride, const VkQueryResultFlags flags )
+{
+    const VkResult result = vkGetQueryPoolResults( core->device, pool, first_query, query_count, data_size, data, stride, flags );
+    if ( result == VK_NOT_READY )
+        return false;
+
+    VK_CHECK( result );
+    return true;
+}
+
+VkSemaphore create_semaphore( const void* p_next )
+{
+    const VkSemaphoreCreateInfo create_info {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = p_next,
+        .flags = 0x0,
+    };
+
+    VkSemaphore semaphore { VK_NULL_HANDLE };
+    VK_CHECK( vkCreateSemaphore( core->device, &create_info, nullptr, &semaphore ) );
+    return semaphore;
+}
+
+void destroy_semaphore( const VkSemaphore semaphore )
+{
+    vkDestroySemaphore( core->device, semaphore, nullptr );
+}
+
+VkSemaphore create_timeline_semaphore( const uint64_t initial_value )
+{
+    const VkSemaphoreTypeCreateInfo type_create_info {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .pNext = nullptr,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = initial_value,
+    };
+
+    return create_semaphore( &type_create_info );
+}
+
+uint64_t get_semaphore_counter_value( const VkSemaphore semaphore )
+{
+    uint64_t value { 0 };
+    VK_CHECK( vkGetSemaphoreCounterValue( core->device, semaphore, &value ) );
+    return value;
+}
+
+bool wait_semaphore( const VkSemaphore semaphore, const uint64_t value, const uint64_t timeout )
+{
+    return wait_semaphores( 1, &semaphore, &value, timeout );
+}
+
+bool wait_semaphores( const uint32_t count, const VkSemaphore* const semaphores, const uint64_t* const values, const uint64_t timeout, const bool wait_any )
+{
+    const VkSemaphoreWaitInfo wait_info {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .pNext = nullptr,
+        .flags = wait_any ? VK_SEMAPHORE_WAIT_ANY_BIT : static_cast<VkSemaphoreWaitFlags>( 0x0 ),
+        .semaphoreCount = count,
+        .pSemaphores = semaphores,
+        .pValues = values,
+    };
+
+    const VkResult result = vkWaitSemaphores( core->device, &wait_info, timeout );
+    if ( result == VK_TIMEOUT )
+        return false;
+
+    VK_CHECK( result );
+    return true;
+}
+
+void signal_semaphore( const VkSemaphore semaphore, const uint64_t value )
+{
+    const VkSemaphoreSignalInfo signal_info {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO,
+        .pNext = nullptr,
+        .semaphore = semaphore,
+        .value = value,
+    };
+
+    VK_CHECK( vkSignalSemaphore( core->device, &signal_info ) );
+}
+
+void queue_submit( const VkQueue queue, const uint32_t cmd_buff_count, const VkCommandBuffer* const cmd_buffs, const std::vector<SemaphoreSubmit>& waits, const std::vector<SemaphoreSubmit>& signals, const VkFence fence )
+{
+    std::vector<VkSemaphore> wait_semaphores( waits.size(), VK_NULL_HANDLE );
+    std::vector<uint64_t> wait_values( waits.size(), 0 );
+    std::vector<VkPipelineStageFlags> wait_stages( waits.size(), 0x0 );
+    for ( uint32_t i = 0; i < waits.size(); i++ )
+    {
+        wait_semaphores[i] = waits[i].semaphore;
+        wait_values[i] = waits[i].value;
+        wait_stages[i] = waits[i].stage;
+    }
+
+    std::vector<VkSemaphore> signal_semaphores( signals.size(), VK_NULL_HANDLE );
+    std::vector<uint64_t> signal_values( signals.size(), 0 );
+    for ( uint32_t i = 0; i < signals.size(); i++ )
+    {
+        signal_semaphores[i] = signals[i].semaphore;
+        signal_values[i] = signals[i].value;
+    }
+
+    // Values of binary semaphores are ignored, so binary and timeline semaphores can be mixed freely
+    const VkTimelineSemaphoreSubmitInfo timeline_info {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .waitSemaphoreValueCount = static_cast<uint32_t>( wait_values.size() ),
+        .pWaitSemaphoreValues = wait_values.data(),
+        .signalSemaphoreValueCount = static_cast<uint32_t>( signal_values.size() ),
+        .pSignalSemaphoreValues = signal_values.data(),
+    };
+
+    const VkSubmitInfo submit_info {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &timeline_info,
+        .waitSemaphoreCount = static_cast<uint32_t>( wait_semaphores.size() ),
+        .pWaitSemaphores = wait_semaphores.data(),
+        .pWaitDstStageMask = wait_stages.data(),
+        .commandBufferCount = cmd_buff_count,
+        .pCommandBuffers = cmd_buffs,
+        .signalSemaphoreCount = static_cast<uint32_t>( signal_semaphores.size() ),
+        .pSignalSemaphores = signal_semaphores.data(),
+    };
+
+    VK_CHECK( vkQueueSubmit( queue, 1, &submit_info, fence ) );
+}
+
+VkBufferMemoryBarrier make_buffer_ownership_barrier( const VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize size, const uint32_t src_queue_family_index, const uint32_t dst_queue_family_index, const VkAccessFlags src_access, const VkAccessFlags dst_access )
+{
+    const VkBufferMemoryBarrier barrier {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = src_access,
+        .dstAccessMask = dst_access,
+        .srcQueueFamilyIndex = src_queue_family_index,
+        .dstQueueFamilyIndex = dst_queue_family_index,
+        .buffer = buffer,
+        .offset = offset,
+        .size = size,
+    };
+
+    return barrier;
+}
+
+void cmd_release_buffer_ownership( const VkCommandBuffer cmd_buff, const VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize size, const uint32_t src_queue_family_index, const uint32_t dst_queue_family_index, const VkPipelineStageFlags src_stage, const VkAccessFlags src_access )
+{
+    if ( src_queue_family_index == dst_queue_family_index )
+        return;
+
+    // dstAccessMask is ignored for a release, the destination half is expressed by the acquire
+    const VkBufferMemoryBarrier barrier = make_buffer_ownership_barrier( buffer, offset, size, src_queue_family_index, dst_queue_family_index, src_access, 0x0 );
+    vkCmdPipelineBarrier( cmd_buff, src_stage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0x0, 0, nullptr, 1, &barrier, 0, nullptr );
+}
+
+void cmd_acquire_buffer_ownership( const VkCommandBuffer cmd_buff, const VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize size, const uint32_t src_queue_family_index, const uint32_t dst_queue_family_index, const VkPipelineStageFlags dst_stage, const VkAccessFlags dst_access )
+{
+    if ( src_queue_family_index == dst_queue_family_index )
+        return;
+
+    // srcAccessMask is ignored for an acquire, availability was performed by the release
+    const VkBufferMemoryBarrier barrier = make_buffer_ownership_barrier( buffer, offset, size, src_queue_family_index, dst_queue_family_index, 0x0, dst_access );
+    vkCmdPipelineBarrier( cmd_buff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dst_stage, 0x0, 0, nullptr, 1, &barrier, 0, nullptr );
+}
+
+static constexpr VkAccessFlags2 write_access_mask = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT |
+    VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+static VkBufferMemoryBarrier2& get_batch_barrier( BarrierBatch& batch, const VkBuffer buffer )
+{
+    for ( VkBufferMemoryBarrier2& barrier : batch.buffer_barriers )
+    {
+        if ( barrier.buffer == buffer && barrier.srcQueueFamilyIndex == VK_QUEUE_FAMILY_IGNORED )
+            return barrier;
+    }
+
+    batch.buffer_barriers.push_back( {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .pNext = nullptr,
+        .srcStageMask = VK_PIPELINE_STAGE_2_NONE,
+        .srcAccessMask = VK_ACCESS_2_NONE,
+        .dstStageMask = VK_PIPELINE_STAGE_2_NONE,
+        .dstAccessMask = VK_ACCESS_2_NONE,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    } );
+
+    return batch.buffer_barriers.back();
+}
+
+void use_buffer( BarrierBatch& batch, BufferSyncState& state, const VkBuffer buffer, const VkPipelineStageFlags2 stage, const VkAccessFlags2 access, const uint32_t queue_family_index )
+{
+    ASSERT( queue_family_index == VK_QUEUE_FAMILY_IGNORED || state.queue_family_index == VK_QUEUE_FAMILY_IGNORED || queue_family_index == state.queue_family_index,
+        "Buffer used on queue family %u while owned by %u, acquire it first!\n", queue_family_index, state.queue_family_index );
+
+    if ( queue_family_index != VK_QUEUE_FAMILY_IGNORED && state.queue_family_index != queue_family_index )
+        state.queue_family_index = queue_family_index;
+
+    const VkAccessFlags2 read_access = access & ~write_access_mask;
+    const VkAccessFlags2 write_access = access & write_access_mask;
+
+    VkPipelineStageFlags2 src_stage = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 src_access = VK_ACCESS_2_NONE;
+    VkPipelineStageFlags2 dst_stage = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 dst_access = VK_ACCESS_2_NONE;
+
+    // Read after write, unless an earlier barrier already made the write visible to this access
+    const bool visible = ( state.visible_stage & stage ) == stage && ( state.visible_access & read_access ) == read_access;
+    if ( read_access != VK_ACCESS_2_NONE && state.write_stage != VK_PIPELINE_STAGE_2_NONE && !visible )
+    {
+        src_stage |= state.write_stage;
+        src_access |= state.write_access;
+        dst_stage |= stage;
+        dst_access |= read_access;
+    }
+
+    if ( write_access != VK_ACCESS_2_NONE )
+    {
+        // Write after read only needs the reads to have executed
+        if ( state.read_stage != VK_PIPELINE_STAGE_2_NONE )
+        {
+            src_stage |= state.read_stage;
+            dst_stage |= stage;
+        }
+
+        if ( state.write_stage != VK_PIPELINE_STAGE_2_NONE )
+        {
+            src_stage |= state.write_stage;
+            src_access |= state.write_access;
+            dst_stage |= stage;
+            dst_access |= access;
+        }
+    }
+
+    if ( src_stage != VK_PIPELINE_STAGE_2_NONE )
+    {
+        VkBufferMemoryBarrier2& barrier = get_batch_barrier( batch, buffer );
+        barrier.srcStageMask |= src_stage;
+        barrier.srcAccessMask |= src_access;
+        barrier.dstStageMask |= dst_stage;
+        barrier.dstAccessMask |= dst_access;
+
+        if ( src_access & state.write_access )
+        {
+            state.visible_stage |= dst_stage;
+            state.visible_access |= dst_access;
+        }
+    }
+
+    if ( write_access != VK_ACCESS_2_NONE )
+    {
+        state.write_stage = stage;
+        state.write_access = write_access;
+        state.read_stage = VK_PIPELINE_STAGE_2_NONE;
+        state.visible_stage = VK_PIPELINE_STAGE_2_NONE;
+        state.visible_access = VK_ACCESS_2_NONE;
+    }
+    else if ( ( state.read_stage & stage ) != stage )
+    {
+        // Only written when it changes, so reads already recorded leave the state untouched
+        state.read_stage |= stage;
+    }
+}
+
+void acquire_buffer( BarrierBatch& batch, BufferSyncState& state, const VkBuffer buffer, const uint32_t src_queue_family_index, const uint32_t dst_queue_family_index, const VkPipelineStageFlags2 stage, const VkAccessFlags2 access )
+{
+    if ( src_queue_family_index == dst_queue_family_index )
+        return;
+
+    // srcAccessMask is ignored for an acquire, availability was performed by the release
+    batch.buffer_barriers.push_back( {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .pNext = nullptr,
+        .srcStageMask = VK_PIPELINE_STAGE_2_NONE,
+        .srcAccessMask = VK_ACCESS_2_NONE,
+        .dstStageMask = stage,
+        .dstAccessMask = access,
+        .srcQueueFamilyIndex = src_queue_family_index,
+        .dstQueueFamilyIndex = dst_queue_family_index,
+        .buffer = buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    } );
+
+    // The semaphore waited on before the acquire orders everything the source queue did. The acquire is the last
+    // write on this queue, later accesses at other stages are chained after it.
+    state = {
+        .write_stage = stage,
+        .write_access = access,
+        .read_stage = VK_PIPELINE_STAGE_2_NONE,
+        .visible_stage = stage,
+        .visible_access = access,
+        .queue_family_index = dst_queue_family_index,
+    };
+}
+
+void flush_barriers( const VkCommandBuffer cmd_buff, BarrierBatch& batch )
+{
+    if ( batch.buffer_barriers.empty() )
+        return;
+
+    const VkDependencyInfo dependency_info {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = 0x0,
+        .memoryBarrierCount = 0,
+        .pMemoryBarriers = nullptr,
+        .bufferMemoryBarrierCount = static_cast<uint32_t>( batch.buffer_barriers.size() ),
+        .pBufferMemoryBarriers = batch.buffer_barriers.data(),
+        .imageMemoryBarrierCount = 0,
+        .pImageMemoryBarriers = nullptr,
+    };
+
+    vkCmdPipelineBarrier2( cmd_buff, &dependency_info );
+    batch.buffer_barriers.clear();
 }
 
 }; // vkn
\ No newline at end of file
@@ -97,6 +97,54 @@ struct Memory : public VkResource
 };
 
 
+// A sub-range of a VkDeviceMemory block handed out by the vkn allocator. Host visible allocations are
+// persistently mapped, mapped_ptr already points at offset.
+struct Allocation
+{
+    VkDeviceMemory memory { VK_NULL_HANDLE };
+    VkDeviceSize offset { 0 };
+    VkDeviceSize size { 0 };
+    void* mapped_ptr { nullptr };
+
+    uint32_t pool_index { UINT32_MAX };
+    uint32_t block_index { UINT32_MAX };  // UINT32_MAX for dedicated allocations
+    uint32_t range_index { UINT32_MAX };
+};
+
+enum class ResourceKind : uint32_t
+{
+    LINEAR = 0,     // buffers, linear images
+    OPTIMAL = 1,    // optimally tiled images
+    COUNT = 2,
+};
+
+struct MemoryStats
+{
+    uint32_t block_count { 0 };
+    uint32_t dedicated_allocation_count { 0 };
+    uint32_t allocation_count { 0 };
+    uint32_t free_range_count { 0 };
+    VkDeviceSize reserved_bytes { 0 };
+    VkDeviceSize used_bytes { 0 };
+    VkDeviceSize free_bytes { 0 };
+    VkDeviceSize largest_free_range { 0 };
+
+    // 0 when all free space is one contiguous range, approaching 1 as it is split into many small ranges
+    float get_fragmentation() const { return free_bytes == 0 ? 0.0f : 1.0f - static_cast<float>( largest_free_range ) / static_cast<float>( free_bytes ); }
+};
+
+// Compute kernels declare these as specialization constants: local_size_x_id = 0, constant_id 1 = elements per
+// thread, constant_id 2 = unroll factor, constant_id 3 = vectorised (uvec4) instead of scalar loads.
+struct ComputeSpecialization
+{
+    uint32_t local_size_x { 0 };
+    uint32_t elements_per_thread { 0 };
+    uint32_t unroll { 0 };
+    VkBool32 vectorized { VK_TRUE };
+
+    bool operator==( const ComputeSpecialization& ) const = default;
+};
+
 struct CommandBuffer
 {
     VkCommandBuffer handle { VK_NULL_HANDLE };
@@ -116,30 +164,83 @@ void request_features( );
 void init( const std::string_view json_path );
 void destroy();
 
+// Probes for a Vulkan 1.3 device with a compute queue, usable before init()
+bool is_device_available();
+
+// With "multi_device" in the device config every selected physical device gets its own logical device, otherwise
+// there is exactly one. All other vkn calls operate on the current device, objects have to be used and destroyed
+// while the device that created them is current. Device 0 is the best match and owns the swapchain.
+uint32_t get_device_count();
+uint32_t get_current_device_index();
+void set_current_device( const uint32_t device_index );
+
 void device_wait_idle();
 
 uint32_t acquire_next_image( const uint64_t timeout, const VkSemaphore semaphore, const VkFence fence );
 
+const VkPhysicalDeviceProperties& get_physical_device_properties();
+const VkPhysicalDeviceSubgroupProperties& get_physical_device_subgroup_properties();
+const VkPhysicalDeviceIDProperties& get_physical_device_id_properties();
+const VkPhysicalDeviceMaintenance4Properties& get_physical_device_maintenance4_properties();   // maxBufferSize
+
 VkQueue get_queue( const uint32_t index );
+uint32_t get_queue_count();
 uint32_t get_queue_family_index();
+uint32_t get_queue_family_index( const uint32_t queue_index );
+const VkQueueFamilyProperties& get_queue_family_properties( const uint32_t queue_family_index );
 
 VkBuffer create_buffer( const VkBufferUsageFlags buffer_usage, const VkDeviceSize size );
 VkBuffer create_buffer( const VkBufferCreateInfo& create_info );
 void destroy_buffer( const VkBuffer buffer );
+VkDeviceAddress get_device_address( const VkBuffer buffer ); // buffer created with SHADER_DEVICE_ADDRESS usage and bound to memory
 
 VkDeviceMemory alloc_buffer_memory( const VkBuffer buffer, const VkMemoryPropertyFlags mem_props );
+VkDeviceMemory alloc_memory( const VkDeviceSize size, const uint32_t memory_type_index, const void* const p_next = nullptr );
+VkMemoryRequirements get_buffer_memory_requirements( const VkBuffer buffer );
+uint32_t get_memory_type_index( const uint32_t memory_type_bits, const VkMemoryPropertyFlags mem_props );
+const VkPhysicalDeviceMemoryProperties& get_physical_device_memory_properties();
+// What the process may still allocate from the heap (VK_EXT_memory_budget), the heap size when it is not supported
+VkDeviceSize get_memory_heap_budget( const uint32_t heap_index );
+
+// Sub-allocating allocator (vkn_allocator.cpp). Allocations come out of large per memory type blocks.
+Allocation allocate_memory( const VkMemoryRequirements& mem_reqs, const VkMemoryPropertyFlags mem_props, const ResourceKind kind = ResourceKind::LINEAR );
+Allocation allocate_buffer_memory( const VkBuffer buffer, const VkMemoryPropertyFlags mem_props );
+void free_allocation( const Allocation& allocation );
+VkMemoryPropertyFlags get_memory_property_flags( const Allocation& allocation ); // of the memory type it came from
+MemoryStats get_memory_stats( const uint32_t memory_type_index );
+MemoryStats get_memory_stats();
+void log_memory_stats();
 void bind_buffer_memory( const VkBuffer buffer, const VkDeviceMemory memory, const VkDeviceSize offset );
 void map_memory( const VkDeviceMemory memory, const uint64_t offset, const VkDeviceSize size, void** data );
 void unmap_memory( const VkDeviceMemory memory );
+void invalidate_mapped_memory( const VkDeviceMemory memory, const VkDeviceSize offset, const VkDeviceSize size ); // non-coherent memory only, range in nonCoherentAtomSize units
 void free_memory( const VkDeviceMemory memory );
 
-VkShaderModule create_shader_module( const std::string_view file_path );
+VkShaderModule create_shader_module( const size_t code_size, const uint32_t* const code );
 void destroy_shader_module( const VkShaderModule module );
 
+// Cached SPIR-V modules (vkn_shader.cpp). name is a file (".spv" appended when missing) looked up in the config's
+// "shader_search_paths". Repeated acquires of a loaded module do no file I/O, every acquire needs a release.
+VkShaderModule acquire_shader_module( const std::string_view name );
+void release_shader_module( const VkShaderModule module );
+
 VkPipelineLayout create_pipeline_layout( const VkPipelineLayoutCreateInfo& create_info );
 void destroy_pipeline_layout( const VkPipelineLayout layout );
 
+// Pipelines are created through one VkPipelineCache, loaded at init from the config's "pipeline_cache_path"
+// (when written by the same device and driver) and saved back at destroy.
 VkPipeline create_compute_pipeline( const VkComputePipelineCreateInfo& create_info );
+VkPipeline create_compute_pipeline( const VkShaderModule module, const VkPipelineLayout layout, const ComputeSpecialization& specialization );
+
+// The autotuned specialization of the kernel for this device and driver when the config's "tuning_path" has one,
+// otherwise derived from the subgroup size and the device limits
+ComputeSpecialization select_compute_specialization( const std::string_view kernel_name );
+bool is_compute_specialization_supported( const ComputeSpecialization& specialization );
+
+// Autotuning results (vkn_tuning.cpp), persisted per device UUID and driver version
+void set_tuned_compute_specialization( const std::string_view kernel_name, const ComputeSpecialization& specialization );
+void save_tuned_compute_specializations();
+void save_pipeline_cache();
 void destroy_pipeline( const VkPipeline pipeline );
 
 VkDescriptorSetLayout create_desc_set_layout( const uint32_t binding_count, const VkDescriptorSetLayoutBinding* const bindings, const VkDescriptorSetLayoutCreateFlags flags = 0x0, const void* const p_next = nullptr );
@@ -154,6 +255,7 @@ std::vector<VkDescriptorSet> alloc_desc_sets( const VkDescriptorPool pool, const
 void write_desc_sets( const uint32_t write_count, const VkWriteDescriptorSet* write_desc_sets );
 
 VkCommandPool create_command_pool( const VkCommandPoolCreateFlags flags );
+VkCommandPool create_command_pool( const VkCommandPoolCreateFlags flags, const uint32_t queue_family_index );
 void reset_command_pool( const VkCommandPool pool );
 void destroy_command_pool( const VkCommandPool pool );
 
@@ -162,11 +264,92 @@ std::vector<VkCommandBuffer> allocate_command_buffers( const VkCommandPool cmd_p
 
 VkFence create_fence( const VkFenceCreateFlags flags = 0x0, const void* p_next = nullptr );
 void wait_for_fence( const VkFence fence, const uint64_t timeout );
+bool is_fence_signaled( const VkFence fence );
 void wait_for_fences( );
 void reset_fence( const VkFence fence );
 void reset_fences( );
 void destroy_fence( const VkFence fence );
 
+VkQueryPool create_query_pool( const VkQueryType type, const uint32_t query_count );
+void destroy_query_pool( const VkQueryPool pool );
+void reset_query_pool( const VkQueryPool pool, const uint32_t first_query, const uint32_t query_count ); // host side reset
+bool get_query_pool_results( const VkQueryPool pool, const uint32_t first_query, const uint32_t query_count, const size_t data_size, void* const data, const VkDeviceSize stride, const VkQueryResultFlags flags ); // false when VK_NOT_READY
+
+VkSemaphore create_semaphore( const void* p_next = nullptr );
+void destroy_semaphore( const VkSemaphore semaphore );
+
+// Timeline semaphores. The GPU signals increasing values on submit, the host waits for (or polls) the value
+// belonging to the work it actually depends on instead of idling the whole device.
+VkSemaphore create_timeline_semaphore( const uint64_t initial_value = 0 );
+uint64_t get_semaphore_counter_value( const VkSemaphore semaphore );
+bool wait_semaphore( const VkSemaphore semaphore, const uint64_t value, const uint64_t timeout = UINT64_MAX ); // false on timeout
+bool wait_semaphores( const uint32_t count, const VkSemaphore* const semaphores, const uint64_t* const values, const uint64_t timeout = UINT64_MAX, const bool wait_any = false );
+void signal_semaphore( const VkSemaphore semaphore, const uint64_t value );
+
+// value is ignored for binary semaphores, stage is ignored for signals
+struct SemaphoreSubmit
+{
+    VkSemaphore semaphore { VK_NULL_HANDLE };
+    uint64_t value { 0 };
+    VkPipelineStageFlags stage { VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+};
+
+void queue_submit( const VkQueue queue, const uint32_t cmd_buff_count, const VkCommandBuffer* const cmd_buffs, const std::vector<SemaphoreSubmit>& waits = {}, const std::vector<SemaphoreSubmit>& signals = {}, const VkFence fence = VK_NULL_HANDLE );
+
+// Submission scheduler over the configured queues. Batches are collected per queue and flushed with one
+// vkQueueSubmit2 per queue. Every batch also signals its queue's timeline, the returned ticket waits for it.
+struct SubmitTicket
+{
+    uint32_t queue_index { UINT32_MAX };
+    uint64_t value { 0 };
+};
+
+// Index of the queue with the least enqueued or executing batches among the queues supporting required_flags
+// (and of the given family unless ignored), equally loaded queues take turns
+uint32_t select_queue( const VkQueueFlags required_flags = VK_QUEUE_COMPUTE_BIT, const uint32_t queue_family_index = VK_QUEUE_FAMILY_IGNORED );
+SubmitTicket enqueue_submit( const uint32_t queue_index, const uint32_t cmd_buff_count, const VkCommandBuffer* const cmd_buffs, const std::vector<SemaphoreSubmit>& waits = {}, const std::vector<SemaphoreSubmit>& signals = {} );
+void flush_submits();
+void flush_submits( const uint32_t queue_index );
+bool is_submit_complete( const SubmitTicket& ticket );
+bool wait_submit( const SubmitTicket& ticket, const uint64_t timeout = UINT64_MAX ); // flushes the queue if needed, false on timeout
+VkSemaphore get_submit_timeline( const uint32_t queue_index ); // for waits on another queue, pair with a ticket value
+
+// Queue family ownership transfer of a buffer range. The release is recorded on the source queue, the matching
+// acquire (same range and families) on the destination queue, ordered by a semaphore between the two submissions.
+// Both are no-ops when the families are equal.
+VkBufferMemoryBarrier make_buffer_ownership_barrier( const VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize size, const uint32_t src_queue_family_index, const uint32_t dst_queue_family_index, const VkAccessFlags src_access, const VkAccessFlags dst_access );
+void cmd_release_buffer_ownership( const VkCommandBuffer cmd_buff, const VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize size, const uint32_t src_queue_family_index, const uint32_t dst_queue_family_index, const VkPipelineStageFlags src_stage, const VkAccessFlags src_access );
+void cmd_acquire_buffer_ownership( const VkCommandBuffer cmd_buff, const VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize size, const uint32_t src_queue_family_index, const uint32_t dst_queue_family_index, const VkPipelineStageFlags dst_stage, const VkAccessFlags dst_access );
+
+// Per buffer synchronization state. use_buffer() is called for every buffer the next command accesses and adds
+// the barriers the access needs to the batch (read after read needs none), flush_barriers() records the whole
+// batch with one vkCmdPipelineBarrier2 right before the command. The state follows recording order, so a buffer
+// has to be recorded for in submission order.
+struct BufferSyncState
+{
+    VkPipelineStageFlags2 write_stage { VK_PIPELINE_STAGE_2_NONE };     // last write
+    VkAccessFlags2 write_access { VK_ACCESS_2_NONE };
+    VkPipelineStageFlags2 read_stage { VK_PIPELINE_STAGE_2_NONE };      // reads since the last write
+    VkPipelineStageFlags2 visible_stage { VK_PIPELINE_STAGE_2_NONE };   // the last write is visible to these
+    VkAccessFlags2 visible_access { VK_ACCESS_2_NONE };
+    uint32_t queue_family_index { VK_QUEUE_FAMILY_IGNORED };            // owning family, IGNORED until first use
+};
+
+struct BarrierBatch
+{
+    std::vector<VkBufferMemoryBarrier2> buffer_barriers;    // at most one per buffer
+};
+
+void use_buffer( BarrierBatch& batch, BufferSyncState& state, const VkBuffer buffer, const VkPipelineStageFlags2 stage, const VkAccessFlags2 access, const uint32_t queue_family_index = VK_QUEUE_FAMILY_IGNORED );
+// Acquire half of an ownership transfer, the release was recorded on the source queue
+void acquire_buffer( BarrierBatch& batch, BufferSyncState& state, const VkBuffer buffer, const uint32_t src_queue_family_index, const uint32_t dst_queue_family_index, const VkPipelineStageFlags2 stage, const VkAccessFlags2 access );
+void flush_barriers( const VkCommandBuffer cmd_buff, BarrierBatch& batch );
+
+// Kernels reach their buffers through device addresses in push constants, so every compute pipeline shares one
+// layout per device without descriptor sets: push_constant_size bytes of compute push constants.
+static constexpr uint32_t push_constant_size = 128;
+VkPipelineLayout get_push_constant_pipeline_layout();
+
 }; // vkn
 
 #endif // VKN_HPP
\ No newline at end of file
@@ -0,0 +1,629 @@
+#include "vkn.hpp"
+#include "vkn_allocator.hpp"
+#include "defines.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <memory>
+#include <vector>
+
+namespace vkn
+{
+
+namespace
+{
+
+static constexpr uint32_t NIL = UINT32_MAX;
+
+static constexpr VkDeviceSize max_block_size = 64ull << 20;
+
+static VkDeviceSize align_up( const VkDeviceSize value, const VkDeviceSize alignment )
+{
+    return ( alignment > 1 ) ? ( ( value + alignment - 1 ) / alignment ) * alignment : value;
+}
+
+// Two-level segregated fit over a single VkDeviceMemory block. Range metadata lives on the host, so nothing is
+// ever written into device memory and free ranges of any size can be tracked. Allocate and free are O(1):
+// the first level splits sizes by power of two, the second level splits each power of two into SL_COUNT
+// linear steps, and two bitmaps locate the first non-empty list that is guaranteed to fit.
+class Tlsf
+{
+public:
+    static constexpr uint32_t SL_BITS = 5;
+    static constexpr uint32_t SL_COUNT = 1u << SL_BITS;
+    static constexpr uint32_t FL_COUNT = 64 - SL_BITS + 1;
+
+private:
+    struct Range
+    {
+        VkDeviceSize offset { 0 };
+        VkDeviceSize size { 0 };
+        uint32_t prev_phys { NIL };
+        uint32_t next_phys { NIL };
+        uint32_t prev_free { NIL };
+        uint32_t next_free { NIL };
+        bool is_free { false };
+    };
+
+    std::vector<Range> ranges;
+    std::vector<uint32_t> unused_range_indices;
+
+    uint64_t fl_bitmap { 0 };
+    std::array<uint32_t, FL_COUNT> sl_bitmaps {};
+    std::array<std::array<uint32_t, SL_COUNT>, FL_COUNT> free_heads;
+
+    VkDeviceSize used_bytes { 0 };
+    uint32_t allocation_count { 0 };
+
+    static void mapping_insert( const VkDeviceSize size, uint32_t& fl, uint32_t& sl )
+    {
+        if ( size < SL_COUNT )
+        {
+            fl = 0;
+            sl = static_cast<uint32_t>( size );
+            return;
+        }
+
+        const uint32_t msb = 63 - static_cast<uint32_t>( std::countl_zero( size ) );
+        fl = msb - SL_BITS + 1;
+        sl = static_cast<uint32_t>( size >> ( msb - SL_BITS ) ) - SL_COUNT;
+    }
+
+    // Rounds up to the next list boundary so every range in the returned list is large enough.
+    static void mapping_search( VkDeviceSize size, uint32_t& fl, uint32_t& sl )
+    {
+        if ( size >= SL_COUNT )
+        {
+            const uint32_t msb = 63 - static_cast<uint32_t>( std::countl_zero( size ) );
+            size += ( 1ull << ( msb - SL_BITS ) ) - 1;
+        }
+
+        mapping_insert( size, fl, sl );
+    }
+
+    uint32_t create_range( const VkDeviceSize offset, const VkDeviceSize size )
+    {
+        uint32_t idx = NIL;
+
+        if ( !unused_range_indices.empty() )
+        {
+            idx = unused_range_indices.back();
+            unused_range_indices.pop_back();
+            ranges[idx] = Range {};
+        }
+        else
+        {
+            idx = static_cast<uint32_t>( ranges.size() );
+            ranges.emplace_back();
+        }
+
+        ranges[idx].offset = offset;
+        ranges[idx].size = size;
+        return idx;
+    }
+
+    void release_range( const uint32_t idx )
+    {
+        unused_range_indices.push_back( idx );
+    }
+
+    void insert_free( const uint32_t idx )
+    {
+        uint32_t fl, sl;
+        mapping_insert( ranges[idx].size, fl, sl );
+
+        const uint32_t head = free_heads[fl][sl];
+        ranges[idx].is_free = true;
+        ranges[idx].prev_free = NIL;
+        ranges[idx].next_free = head;
+
+        if ( head != NIL )
+            ranges[head].prev_free = idx;
+
+        free_heads[fl][sl] = idx;
+        fl_bitmap |= ( 1ull << fl );
+        sl_bitmaps[fl] |= ( 1u << sl );
+    }
+
+    void remove_free( const uint32_t idx )
+    {
+        uint32_t fl, sl;
+        mapping_insert( ranges[idx].size, fl, sl );
+
+        const uint32_t prev = ranges[idx].prev_free;
+        const uint32_t next = ranges[idx].next_free;
+
+        if ( prev != NIL )
+            ranges[prev].next_free = next;
+        else
+            free_heads[fl][sl] = next;
+
+        if ( next != NIL )
+            ranges[next].prev_free = prev;
+
+        if ( free_heads[fl][sl] == NIL )
+        {
+            sl_bitmaps[fl] &= ~( 1u << sl );
+            if ( sl_bitmaps[fl] == 0 )
+                fl_bitmap &= ~( 1ull << fl );
+        }
+
+        ranges[idx].is_free = false;
+        ranges[idx].prev_free = NIL;
+        ranges[idx].next_free = NIL;
+    }
+
+    uint32_t find_free( const VkDeviceSize size ) const
+    {
+        uint32_t fl, sl;
+        mapping_search( size, fl, sl );
+
+        if ( fl >= FL_COUNT )
+            return NIL;
+
+        uint32_t sl_map = sl_bitmaps[fl] & ( ~0u << sl );
+        if ( sl_map == 0 )
+        {
+            const uint64_t fl_map = ( fl + 1 < 64 ) ? ( fl_bitmap & ( ~0ull << ( fl + 1 ) ) ) : 0;
+            if ( fl_map == 0 )
+                return NIL;
+
+            fl = static_cast<uint32_t>( std::countr_zero( fl_map ) );
+            sl_map = sl_bitmaps[fl];
+        }
+
+        sl = static_cast<uint32_t>( std::countr_zero( sl_map ) );
+        return free_heads[fl][sl];
+    }
+
+public:
+    Tlsf( const VkDeviceSize size )
+    {
+        for ( std::array<uint32_t, SL_COUNT>& heads : free_heads )
+            heads.fill( NIL );
+
+        insert_free( create_range( 0, size ) );
+    }
+
+    // Returns the range index backing the allocation, or NIL if the block cannot fit it.
+    uint32_t allocate( const VkDeviceSize size, const VkDeviceSize alignment, VkDeviceSize& offset )
+    {
+        // Free ranges start at arbitrary offsets, so search for enough slack to align any of them
+        const uint32_t idx = find_free( size + ( ( alignment > 1 ) ? alignment - 1 : 0 ) );
+        if ( idx == NIL )
+            return NIL;
+
+        remove_free( idx );
+
+        const VkDeviceSize aligned_offset = align_up( ranges[idx].offset, alignment );
+        const VkDeviceSize padding = aligned_offset - ranges[idx].offset;
+
+        // Free ranges are always coalesced, so the physical neighbours of idx are in use and the split-off
+        // pieces never need merging here.
+        if ( padding > 0 )
+        {
+            const uint32_t front = create_range( ranges[idx].offset, padding );
+            ranges[front].prev_phys = ranges[idx].prev_phys;
+            ranges[front].next_phys = idx;
+            if ( ranges[idx].prev_phys != NIL )
+                ranges[ranges[idx].prev_phys].next_phys = front;
+            ranges[idx].prev_phys = front;
+            ranges[idx].offset = aligned_offset;
+            ranges[idx].size -= padding;
+            insert_free( front );
+        }
+
+        const VkDeviceSize remainder = ranges[idx].size - size;
+        if ( remainder > 0 )
+        {
+            const uint32_t back = create_range( aligned_offset + size, remainder );
+            ranges[back].prev_phys = idx;
+            ranges[back].next_phys = ranges[idx].next_phys;
+            if ( ranges[idx].next_phys != NIL )
+                ranges[ranges[idx].next_phys].prev_phys = back;
+            ranges[idx].next_phys = back;
+            ranges[idx].size = size;
+            insert_free( back );
+        }
+
+        used_bytes += size;
+        allocation_count++;
+
+        offset = aligned_offset;
+        return idx;
+    }
+
+    void deallocate( uint32_t idx )
+    {
+        assert( !ranges[idx].is_free );
+
+        used_bytes -= ranges[idx].size;
+        allocation_count--;
+
+        const uint32_t prev = ranges[idx].prev_phys;
+        if ( prev != NIL && ranges[prev].is_free )
+        {
+            remove_free( prev );
+            ranges[prev].size += ranges[idx].size;
+            ranges[prev].next_phys = ranges[idx].next_phys;
+            if ( ranges[idx].next_phys != NIL )
+                ranges[ranges[idx].next_phys].prev_phys = prev;
+            release_range( idx );
+            idx = prev;
+        }
+
+        const uint32_t next = ranges[idx].next_phys;
+        if ( next != NIL && ranges[next].is_free )
+        {
+            remove_free( next );
+            ranges[idx].size += ranges[next].size;
+            ranges[idx].next_phys = ranges[next].next_phys;
+            if ( ranges[next].next_phys != NIL )
+                ranges[ranges[next].next_phys].prev_phys = idx;
+            release_range( next );
+        }
+
+        insert_free( idx );
+    }
+
+    bool is_empty() const { return allocation_count == 0; }
+    uint32_t get_allocation_count() const { return allocation_count; }
+    VkDeviceSize get_used_bytes() const { return used_bytes; }
+
+    void accumulate_free_stats( MemoryStats& stats ) const
+    {
+        for ( uint32_t fl = 0; fl < FL_COUNT; fl++ )
+        {
+            if ( ( fl_bitmap & ( 1ull << fl ) ) == 0 )
+                continue;
+
+            for ( uint32_t sl = 0; sl < SL_COUNT; sl++ )
+            {
+                for ( uint32_t idx = free_heads[fl][sl]; idx != NIL; idx = ranges[idx].next_free )
+                {
+                    stats.free_range_count++;
+                    stats.free_bytes += ranges[idx].size;
+                    stats.largest_free_range = std::max( stats.largest_free_range, ranges[idx].size );
+                }
+            }
+        }
+    }
+};
+
+struct Block
+{
+    VkDeviceMemory memory { VK_NULL_HANDLE };
+    VkDeviceSize size { 0 };
+    uint8_t* mapped_ptr { nullptr };
+    std::unique_ptr<Tlsf> tlsf { nullptr };
+};
+
+struct DedicatedAllocation
+{
+    VkDeviceMemory memory { VK_NULL_HANDLE };
+    VkDeviceSize size { 0 };
+};
+
+// One pool per ( memory type, resource kind ). Linear and optimal resources never share a block, so no page
+// can hold both and bufferImageGranularity is satisfied without checking neighbouring ranges.
+struct Pool
+{
+    uint32_t memory_type_index { 0 };
+    VkDeviceSize block_size { 0 };
+    bool host_visible { false };
+    VkDeviceSize min_alignment { 1 };
+    VkMemoryAllocateFlags allocate_flags { 0x0 };
+
+    std::vector<Block> blocks;                      // empty slots have memory == VK_NULL_HANDLE
+    std::vector<DedicatedAllocation> dedicated;     // empty slots have memory == VK_NULL_HANDLE
+};
+
+// One set of pools per vkn device, each device has its own memory types
+static std::vector<std::vector<Pool>> device_pools;
+
+static std::vector<Pool>& get_pools()
+{
+    return device_pools.at( get_current_device_index() );
+}
+
+static uint32_t get_pool_index( const uint32_t memory_type_index, const ResourceKind kind )
+{
+    return memory_type_index * static_cast<uint32_t>( ResourceKind::COUNT ) + static_cast<uint32_t>( kind );
+}
+
+static VkDeviceMemory alloc_pool_memory( const Pool& pool, const VkDeviceSize size )
+{
+    const VkMemoryAllocateFlagsInfo flags_info {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
+        .pNext = nullptr,
+        .flags = pool.allocate_flags,
+        .deviceMask = 0,
+    };
+
+    return alloc_memory( size, pool.memory_type_index, ( pool.allocate_flags != 0 ) ? &flags_info : nullptr );
+}
+
+static uint8_t* map_whole( const VkDeviceMemory memory )
+{
+    void* data = nullptr;
+    map_memory( memory, 0, VK_WHOLE_SIZE, &data );
+    return static_cast<uint8_t*>( data );
+}
+
+static uint32_t create_block( Pool& pool, const VkDeviceSize min_size )
+{
+    uint32_t slot = 0;
+    for ( ; slot < pool.blocks.size(); slot++ )
+    {
+        if ( pool.blocks[slot].memory == VK_NULL_HANDLE )
+            break;
+    }
+
+    if ( slot == pool.blocks.size() )
+        pool.blocks.emplace_back();
+
+    Block& block = pool.blocks[slot];
+    block.size = std::max( pool.block_size, min_size );
+    block.memory = alloc_pool_memory( pool, block.size );
+    block.mapped_ptr = pool.host_visible ? map_whole( block.memory ) : nullptr;
+    block.tlsf = std::make_unique<Tlsf>( block.size );
+    return slot;
+}
+
+static void destroy_block( Block& block )
+{
+    free_memory( block.memory );
+    block = Block {};
+}
+
+}
+
+void init_allocator()
+{
+    const VkPhysicalDeviceMemoryProperties& mem_props = get_physical_device_memory_properties();
+    const VkPhysicalDeviceLimits& limits = get_physical_device_properties().limits;
+
+    if ( device_pools.size() <= get_current_device_index() )
+        device_pools.resize( get_current_device_index() + 1 );
+
+    std::vector<Pool>& pools = get_pools();
+    pools.clear();
+    pools.resize( mem_props.memoryTypeCount * static_cast<uint32_t>( ResourceKind::COUNT ) );
+
+    for ( uint32_t i = 0; i < mem_props.memoryTypeCount; i++ )
+    {
+        const VkMemoryType& type = mem_props.memoryTypes[i];
+        const VkDeviceSize heap_size = mem_props.memoryHeaps[type.heapIndex].size;
+
+        for ( uint32_t kind = 0; kind < static_cast<uint32_t>( ResourceKind::COUNT ); kind++ )
+        {
+            Pool& pool = pools[get_pool_index( i, static_cast<ResourceKind>( kind ) )];
+            pool.memory_type_index = i;
+            // Small heaps (e.g. host visible device local BAR) get proportionally smaller blocks
+            pool.block_size = std::min( max_block_size, align_up( heap_size / 8, 1 << 20 ) );
+            pool.host_visible = ( type.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT ) != 0;
+
+            // Non-coherent ranges are flushed/invalidated in nonCoherentAtomSize units, keep them from sharing atoms
+            const bool host_coherent = ( type.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT ) != 0;
+            pool.min_alignment = ( pool.host_visible && !host_coherent ) ? limits.nonCoherentAtomSize : 1;
+
+            // Any buffer may be created with SHADER_DEVICE_ADDRESS usage, its memory has to allow it
+            pool.allocate_flags = ( static_cast<ResourceKind>( kind ) == ResourceKind::LINEAR ) ? VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT : 0x0;
+        }
+    }
+}
+
+void destroy_allocator()
+{
+    for ( Pool& pool : get_pools() )
+    {
+        for ( Block& block : pool.blocks )
+        {
+            if ( block.memory == VK_NULL_HANDLE )
+                continue;
+
+            if ( !block.tlsf->is_empty() )
+            {
+                LOG( "WARNING - %u allocation(s) leaked in memory type %u!\n", block.tlsf->get_allocation_count(), pool.memory_type_index );
+            }
+
+            destroy_block( block );
+        }
+
+        for ( DedicatedAllocation& dedicated : pool.dedicated )
+        {
+            if ( dedicated.memory == VK_NULL_HANDLE )
+                continue;
+
+            LOG( "WARNING - dedicated allocation leaked in memory type %u!\n", pool.memory_type_index );
+            free_memory( dedicated.memory );
+        }
+    }
+
+    get_pools().clear();
+}
+
+Allocation allocate_memory( const VkMemoryRequirements& mem_reqs, const VkMemoryPropertyFlags mem_props, const ResourceKind kind )
+{
+    const uint32_t memory_type_index = get_memory_type_index( mem_reqs.memoryTypeBits, mem_props );
+    const uint32_t pool_index = get_pool_index( memory_type_index, kind );
+    Pool& pool = get_pools().at( pool_index );
+
+    Allocation allocation {
+        .memory = VK_NULL_HANDLE,
+        .offset = 0,
+        .size = mem_reqs.size,
+        .mapped_ptr = nullptr,
+        .pool_index = pool_index,
+    };
+
+    // Large requests would mostly waste a shared block, give them their own VkDeviceMemory
+    if ( mem_reqs.size > pool.block_size / 2 )
+    {
+        uint32_t slot = 0;
+        for ( ; slot < pool.dedicated.size(); slot++ )
+        {
+            if ( pool.dedicated[slot].memory == VK_NULL_HANDLE )
+                break;
+        }
+
+        if ( slot == pool.dedicated.size() )
+            pool.dedicated.emplace_back();
+
+        pool.dedicated[slot].memory = alloc_pool_memory( pool, mem_reqs.size );
+        pool.dedicated[slot].size = mem_reqs.size;
+
+        allocation.memory = pool.dedicated[slot].memory;
+        allocation.mapped_ptr = pool.host_visible ? map_whole( allocation.memory ) : nullptr;
+        allocation.range_index = slot;
+        return allocation;
+    }
+
+    const VkDeviceSize alignment = std::max( mem_reqs.alignment, pool.min_alignment );
+    const VkDeviceSize size = align_up( mem_reqs.size, pool.min_alignment );
+
+    // Pools hold a handful of blocks at most, the per-block search itself is O(1)
+    for ( uint32_t i = 0; i < pool.blocks.size(); i++ )
+    {
+        Block& block = pool.blocks[i];
+        if ( block.memory == VK_NULL_HANDLE )
+            continue;
+
+        const uint32_t range_index = block.tlsf->allocate( size, alignment, allocation.offset );
+        if ( range_index != NIL )
+        {
+            allocation.memory = block.memory;
+            allocation.mapped_ptr = block.mapped_ptr ? block.mapped_ptr + allocation.offset : nullptr;
+            allocation.block_index = i;
+            allocation.range_index = range_index;
+            return allocation;
+        }
+    }
+
+    const uint32_t block_index = create_block( pool, size + alignment );
+    Block& block = pool.blocks[block_index];
+
+    allocation.range_index = block.tlsf->allocate( size, alignment, allocation.offset );
+    assert( allocation.range_index != NIL );
+
+    allocation.memory = block.memory;
+    allocation.mapped_ptr = block.mapped_ptr ? block.mapped_ptr + allocation.offset : nullptr;
+    allocation.block_index = block_index;
+    return allocation;
+}
+
+Allocation allocate_buffer_memory( const VkBuffer buffer, const VkMemoryPropertyFlags mem_props )
+{
+    return allocate_memory( get_buffer_memory_requirements( buffer ), mem_props, ResourceKind::LINEAR );
+}
+
+void free_allocation( const Allocation& allocation )
+{
+    if ( allocation.memory == VK_NULL_HANDLE )
+        return;
+
+    Pool& pool = get_pools().at( allocation.pool_index );
+
+    if ( allocation.block_index == NIL )
+    {
+        DedicatedAllocation& dedicated = pool.dedicated.at( allocation.range_index );
+        free_memory( dedicated.memory );
+        dedicated = DedicatedAllocation {};
+        return;
+    }
+
+    Block& block = pool.blocks.at( allocation.block_index );
+    block.tlsf->deallocate( allocation.range_index );
+
+    // Keep one block around per pool so alloc/free churn does not hit vkAllocateMemory every time
+    if ( block.tlsf->is_empty() )
+    {
+        uint32_t live_block_count = 0;
+        for ( const Block& b : pool.blocks )
+            live_block_count += ( b.memory != VK_NULL_HANDLE ) ? 1 : 0;
+
+        if ( live_block_count > 1 )
+            destroy_block( block );
+    }
+}
+
+VkMemoryPropertyFlags get_memory_property_flags( const Allocation& allocation )
+{
+    assert( allocation.memory != VK_NULL_HANDLE );
+
+    const uint32_t memory_type_index = allocation.pool_index / static_cast<uint32_t>( ResourceKind::COUNT );
+    return get_physical_device_memory_properties().memoryTypes[memory_type_index].propertyFlags;
+}
+
+MemoryStats get_memory_stats( const uint32_t memory_type_index )
+{
+    MemoryStats stats {};
+
+    for ( uint32_t kind = 0; kind < static_cast<uint32_t>( ResourceKind::COUNT ); kind++ )
+    {
+        const Pool& pool = get_pools().at( get_pool_index( memory_type_index, static_cast<ResourceKind>( kind ) ) );
+
+        for ( const Block& block : pool.blocks )
+        {
+            if ( block.memory == VK_NULL_HANDLE )
+                continue;
+
+            stats.block_count++;
+            stats.allocation_count += block.tlsf->get_allocation_count();
+            stats.reserved_bytes += block.size;
+            stats.used_bytes += block.tlsf->get_used_bytes();
+            block.tlsf->accumulate_free_stats( stats );
+        }
+
+        for ( const DedicatedAllocation& dedicated : pool.dedicated )
+        {
+            if ( dedicated.memory == VK_NULL_HANDLE )
+                continue;
+
+            stats.dedicated_allocation_count++;
+            stats.allocation_count++;
+            stats.reserved_bytes += dedicated.size;
+            stats.used_bytes += dedicated.size;
+        }
+    }
+
+    return stats;
+}
+
+MemoryStats get_memory_stats()
+{
+    MemoryStats total {};
+
+    for ( uint32_t i = 0; i < get_physical_device_memory_properties().memoryTypeCount; i++ )
+    {
+        const MemoryStats stats = get_memory_stats( i );
+        total.block_count += stats.block_count;
+        total.dedicated_allocation_count += stats.dedicated_allocation_count;
+        total.allocation_count += stats.allocation_count;
+        total.free_range_count += stats.free_range_count;
+        total.reserved_bytes += stats.reserved_bytes;
+        total.used_bytes += stats.used_bytes;
+        total.free_bytes += stats.free_bytes;
+        total.largest_free_range = std::max( total.largest_free_range, stats.largest_free_range );
+    }
+
+    return total;
+}
+
+void log_memory_stats()
+{
+    for ( uint32_t i = 0; i < get_physical_device_memory_properties().memoryTypeCount; i++ )
+    {
+        const MemoryStats stats = get_memory_stats( i );
+        if ( stats.reserved_bytes == 0 )
+            continue;
+
+        LOG( "Memory Type %u: %u block(s), %u dedicated, %u allocation(s), %llu / %llu bytes used, %u free range(s), fragmentation %.2f\n",
+            i, stats.block_count, stats.dedicated_allocation_count, stats.allocation_count,
+            (unsigned long long)stats.used_bytes, (unsigned long long)stats.reserved_bytes,
+            stats.free_range_count, stats.get_fragmentation() );
+    }
+}
+
+}; // vkn
@@ -0,0 +1,14 @@
+#ifndef VKN_ALLOCATOR_HPP
+#define VKN_ALLOCATOR_HPP
+
+// Internal to vkn, the public allocation API is declared in vkn.hpp.
+
+namespace vkn
+{
+
+void init_allocator();
+void destroy_allocator();
+
+}; // vkn
+
+#endif // VKN_ALLOCATOR_HPP
@@ -0,0 +1,290 @@
+#include "vkn_profiler.hpp"
+#include "vkn.hpp"
+#include "defines.hpp"
+
+#include "json_parser/json.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace vkn
+{
+
+namespace
+{
+
+struct Region
+{
+    std::string name;
+    std::vector<double> samples_ms;    // rolling window, written round robin
+    uint32_t next_sample { 0 };
+    double last_ms { 0.0 };
+};
+
+struct ScopeRecord
+{
+    uint32_t region_index { 0 };
+    uint64_t valid_mask { 0 };
+};
+
+struct Profiler
+{
+    VkQueryPool query_pool { VK_NULL_HANDLE };
+    uint32_t device_index { 0 };    // vkn device the queries belong to
+    uint32_t max_scopes_per_frame { 0 };
+    uint32_t window_size { 0 };
+    uint32_t default_queue_family_index { 0 };
+    double ms_per_tick { 0.0 };
+
+    std::vector<std::vector<ScopeRecord>> frame_scopes;     // scopes recorded per frame slot, query pair i of the slot
+    uint32_t current_frame { UINT32_MAX };
+
+    std::vector<Region> regions;
+    bool overflow_reported { false };
+
+    std::mutex scope_mutex;     // scopes may be opened from several recording threads
+};
+
+static std::unique_ptr<Profiler> profiler { nullptr };
+
+static uint32_t get_first_query( const uint32_t frame_index )
+{
+    return frame_index * profiler->max_scopes_per_frame * 2;
+}
+
+static uint32_t find_or_add_region( const char* const name )
+{
+    for ( uint32_t i = 0; i < profiler->regions.size(); i++ )
+    {
+        if ( profiler->regions[i].name == name )
+            return i;
+    }
+
+    profiler->regions.push_back( { .name = name } );
+    profiler->regions.back().samples_ms.reserve( profiler->window_size );
+    return static_cast<uint32_t>( profiler->regions.size() - 1 );
+}
+
+static void collect_frame( const uint32_t frame_index, const bool keep_scopes )
+{
+    std::vector<ScopeRecord>& scopes = profiler->frame_scopes[frame_index];
+    if ( scopes.empty() )
+        return;
+
+    // Per query: timestamp followed by its availability, begin and end query of a scope are adjacent
+    std::vector<uint64_t> results( scopes.size() * 4, 0 );
+    vkn::get_query_pool_results( profiler->query_pool, get_first_query( frame_index ), static_cast<uint32_t>( scopes.size() * 2 ),
+        results.size() * sizeof( uint64_t ), results.data(), 2 * sizeof( uint64_t ), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT );
+
+    std::vector<double> frame_totals_ms( profiler->regions.size(), -1.0 );
+
+    for ( uint32_t i = 0; i < scopes.size(); i++ )
+    {
+        const uint64_t* const result = &results[i * 4];
+        if ( result[1] == 0 || result[3] == 0 )
+            continue;
+
+        // Masking the difference handles counters that wrapped within their valid bits
+        const uint64_t ticks = ( result[2] - result[0] ) & scopes[i].valid_mask;
+        double& total_ms = frame_totals_ms[scopes[i].region_index];
+        total_ms = std::max( total_ms, 0.0 ) + static_cast<double>( ticks ) * profiler->ms_per_tick;
+    }
+
+    for ( uint32_t i = 0; i < frame_totals_ms.size(); i++ )
+    {
+        if ( frame_totals_ms[i] < 0.0 )
+            continue;
+
+        Region& region = profiler->regions[i];
+        region.last_ms = frame_totals_ms[i];
+
+        if ( region.samples_ms.size() < profiler->window_size )
+            region.samples_ms.push_back( frame_totals_ms[i] );
+        else
+            region.samples_ms[region.next_sample] = frame_totals_ms[i];
+
+        region.next_sample = ( region.next_sample + 1 ) % profiler->window_size;
+    }
+
+    if ( !keep_scopes )
+        scopes.clear();
+}
+
+}
+
+double get_percentile( const std::vector<double>& sorted, const double fraction )
+{
+    if ( sorted.empty() )
+        return 0.0;
+
+    // Nearest rank
+    const size_t rank = static_cast<size_t>( std::ceil( fraction * static_cast<double>( sorted.size() ) ) );
+    return sorted[std::clamp<size_t>( rank, 1, sorted.size() ) - 1];
+}
+
+void profiler_init( const uint32_t frame_count, const uint32_t default_queue_family_index, const uint32_t max_scopes_per_frame, const uint32_t window_size )
+{
+    ASSERT( frame_count > 0 && max_scopes_per_frame > 0 && window_size > 0, "Invalid profiler configuration!\n" );
+
+    profiler_destroy();
+
+    profiler = std::make_unique<Profiler>();
+    profiler->device_index = get_current_device_index();
+    profiler->max_scopes_per_frame = max_scopes_per_frame;
+    profiler->window_size = window_size;
+    profiler->default_queue_family_index = default_queue_family_index;
+    profiler->ms_per_tick = static_cast<double>( get_physical_device_properties().limits.timestampPeriod ) * 1e-6;
+    profiler->frame_scopes.resize( frame_count );
+
+    const uint32_t query_count = frame_count * max_scopes_per_frame * 2;
+    profiler->query_pool = create_query_pool( VK_QUERY_TYPE_TIMESTAMP, query_count );
+    reset_query_pool( profiler->query_pool, 0, query_count );
+
+    if ( get_queue_family_properties( default_queue_family_index ).timestampValidBits == 0 )
+        LOG( "WARNING - Queue family %u does not support timestamps, GPU scopes on it are ignored!\n", default_queue_family_index );
+}
+
+void profiler_destroy()
+{
+    if ( !profiler )
+        return;
+
+    const uint32_t current_device_index = get_current_device_index();
+    set_current_device( profiler->device_index );
+    destroy_query_pool( profiler->query_pool );
+    set_current_device( current_device_index );
+
+    profiler.reset();
+}
+
+void profiler_begin_frame( const uint32_t frame_index, const bool reuse_scopes )
+{
+    if ( !profiler )
+        return;
+
+    assert( frame_index < profiler->frame_scopes.size() );
+    assert( profiler->device_index == get_current_device_index() );
+
+    collect_frame( frame_index, reuse_scopes );
+    reset_query_pool( profiler->query_pool, get_first_query( frame_index ), profiler->max_scopes_per_frame * 2 );
+
+    profiler->current_frame = frame_index;
+}
+
+void profiler_collect_all()
+{
+    if ( !profiler )
+        return;
+
+    assert( profiler->device_index == get_current_device_index() );
+
+    // Scopes are cleared once collected, a slot begun again afterwards does not count them twice
+    for ( uint32_t i = 0; i < profiler->frame_scopes.size(); i++ )
+        collect_frame( i, false );
+
+    profiler->current_frame = UINT32_MAX;
+}
+
+std::vector<GpuRegionStats> profiler_get_stats()
+{
+    std::vector<GpuRegionStats> stats;
+    if ( !profiler )
+        return stats;
+
+    for ( const Region& region : profiler->regions )
+    {
+        if ( region.samples_ms.empty() )
+            continue;
+
+        std::vector<double> sorted = region.samples_ms;
+        std::sort( sorted.begin(), sorted.end() );
+
+        stats.push_back( {
+            .name = region.name,
+            .sample_count = static_cast<uint32_t>( sorted.size() ),
+            .last_ms = region.last_ms,
+            .min_ms = sorted.front(),
+            .median_ms = get_percentile( sorted, 0.5 ),
+            .p90_ms = get_percentile( sorted, 0.9 ),
+            .p99_ms = get_percentile( sorted, 0.99 ),
+        } );
+    }
+
+    return stats;
+}
+
+void profiler_log_stats()
+{
+    for ( const GpuRegionStats& stats : profiler_get_stats() )
+    {
+        LOG( "GPU %-16s min %8.4f ms, median %8.4f ms, p90 %8.4f ms, p99 %8.4f ms (%u frames)\n",
+            stats.name.c_str(), stats.min_ms, stats.median_ms, stats.p90_ms, stats.p99_ms, stats.sample_count );
+    }
+}
+
+void profiler_dump_json( const std::string_view file_path )
+{
+    nlohmann::json json_data = nlohmann::json::array();
+
+    for ( const GpuRegionStats& stats : profiler_get_stats() )
+    {
+        json_data.push_back( {
+            { "name", stats.name },
+            { "sample_count", stats.sample_count },
+            { "last_ms", stats.last_ms },
+            { "min_ms", stats.min_ms },
+            { "median_ms", stats.median_ms },
+            { "p90_ms", stats.p90_ms },
+            { "p99_ms", stats.p99_ms },
+        } );
+    }
+
+    std::ofstream file( file_path.data() );
+    ASSERT( file.is_open(), "Failed to open profiler output file: %s\n", file_path.data() );
+    file << json_data.dump( 4 ) << '\n';
+}
+
+GpuScope::GpuScope( const VkCommandBuffer _cmd_buff, const char* const name, const uint32_t queue_family_index )
+    : cmd_buff { _cmd_buff }
+{
+    if ( !profiler || profiler->current_frame == UINT32_MAX || profiler->device_index != get_current_device_index() )
+        return;
+
+    const uint32_t family = ( queue_family_index == VK_QUEUE_FAMILY_IGNORED ) ? profiler->default_queue_family_index : queue_family_index;
+    const uint32_t valid_bits = get_queue_family_properties( family ).timestampValidBits;
+    if ( valid_bits == 0 )
+        return;
+
+    std::lock_guard<std::mutex> lock( profiler->scope_mutex );
+
+    std::vector<ScopeRecord>& scopes = profiler->frame_scopes[profiler->current_frame];
+    if ( scopes.size() == profiler->max_scopes_per_frame )
+    {
+        if ( !profiler->overflow_reported )
+            LOG( "WARNING - More than %u GPU scopes in a frame, the rest are ignored!\n", profiler->max_scopes_per_frame );
+
+        profiler->overflow_reported = true;
+        return;
+    }
+
+    query_index = get_first_query( profiler->current_frame ) + static_cast<uint32_t>( scopes.size() ) * 2;
+    scopes.push_back( {
+        .region_index = find_or_add_region( name ),
+        .valid_mask = ( valid_bits >= 64 ) ? UINT64_MAX : ( ( 1ull << valid_bits ) - 1 ),
+    } );
+
+    vkCmdWriteTimestamp( cmd_buff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profiler->query_pool, query_index );
+}
+
+GpuScope::~GpuScope()
+{
+    if ( query_index == UINT32_MAX )
+        return;
+
+    vkCmdWriteTimestamp( cmd_buff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, profiler->query_pool, query_index + 1 );
+}
+
+}; // vkn
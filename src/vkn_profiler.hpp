@@ -0,0 +1,68 @@
+#ifndef VKN_PROFILER_HPP
+#define VKN_PROFILER_HPP
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vkn
+{
+
+// GPU timestamp profiler. Every frame slot (a frame context or in-flight submission slot) owns a range of
+// timestamp queries. A slot's results are read when the slot is begun again, which only happens once its
+// previous submission has retired, so reading them never stalls. Scopes with the same name within one frame
+// are summed, every region keeps a rolling window of per-frame times.
+
+struct GpuRegionStats
+{
+    std::string name;
+    uint32_t sample_count { 0 };
+    double last_ms { 0.0 };
+    double min_ms { 0.0 };
+    double median_ms { 0.0 };
+    double p90_ms { 0.0 };
+    double p99_ms { 0.0 };
+};
+
+// Nearest rank percentile of ascending samples, fraction in [0, 1]
+double get_percentile( const std::vector<double>& sorted, const double fraction );
+
+// Profiles the current vkn device. Timestamps are written on queues of default_queue_family_index unless a
+// scope names another family.
+void profiler_init( const uint32_t frame_count, const uint32_t default_queue_family_index, const uint32_t max_scopes_per_frame = 64, const uint32_t window_size = 256 );
+void profiler_destroy();
+
+// Collects the slot's previous results and resets its queries. Call once the slot's previous submissions have
+// completed and before anything is recorded for it. Scopes recorded outside of a frame are ignored.
+// reuse_scopes keeps the slot's scopes for a resubmission of the command buffers recorded for it.
+void profiler_begin_frame( const uint32_t frame_index, const bool reuse_scopes = false );
+
+// Collects every slot's results. Call once all submissions have completed (e.g. at the end of a run), the
+// last frame_count frames are otherwise only collected when their slots are begun again.
+void profiler_collect_all();
+
+std::vector<GpuRegionStats> profiler_get_stats();
+void profiler_log_stats();
+void profiler_dump_json( const std::string_view file_path );
+
+// Records a timestamp at construction and destruction, name must outlive the current frame (e.g. a literal).
+// A no-op when the profiler is not running, another device is current or the queue family has no timestamp support.
+// Scopes may be opened from several threads recording the current frame.
+class GpuScope
+{
+private:
+    const VkCommandBuffer cmd_buff { VK_NULL_HANDLE };
+    uint32_t query_index { UINT32_MAX };
+public:
+    GpuScope( const VkCommandBuffer _cmd_buff, const char* const name, const uint32_t queue_family_index = VK_QUEUE_FAMILY_IGNORED );
+    ~GpuScope();
+
+    GpuScope( const GpuScope& ) = delete;
+    GpuScope& operator=( const GpuScope& ) = delete;
+};
+
+}; // vkn
+
+#endif // VKN_PROFILER_HPP
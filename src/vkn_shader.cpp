@@ -0,0 +1,169 @@
+#include "vkn.hpp"
+#include "vkn_shader.hpp"
+#include "defines.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace vkn
+{
+
+namespace
+{
+
+static constexpr uint32_t spirv_magic = 0x07230203;
+static constexpr size_t spirv_header_size = 5 * sizeof( uint32_t );
+
+struct CachedModule
+{
+    VkShaderModule module { VK_NULL_HANDLE };
+    uint32_t ref_count { 0 };
+};
+
+struct ShaderCache
+{
+    std::vector<std::string> search_paths;
+    std::unordered_map<std::string, uint64_t> name_to_hash;     // names resolved before, skips the file system entirely
+    std::unordered_map<uint64_t, CachedModule> modules;         // keyed by content hash, identical files share a module
+};
+
+// Modules belong to one device, so does the cache
+static std::vector<ShaderCache> device_caches;
+
+static ShaderCache& get_cache()
+{
+    return device_caches.at( get_current_device_index() );
+}
+
+// FNV-1a, only used to tell files apart
+static uint64_t hash_code( const uint8_t* const data, const size_t size )
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for ( size_t i = 0; i < size; i++ )
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static std::string resolve_path( const std::string& file_name )
+{
+    ShaderCache& cache = get_cache();
+
+    // Absolute paths and paths relative to the working directory win over the search paths
+    if ( access( file_name.c_str(), R_OK ) == 0 )
+        return file_name;
+
+    for ( const std::string& search_path : cache.search_paths )
+    {
+        const std::string path = search_path + "/" + file_name;
+        if ( access( path.c_str(), R_OK ) == 0 )
+            return path;
+    }
+
+    EXIT( "Failed to find shader %s in any search path!\n", file_name.c_str() );
+    return {};
+}
+
+static VkShaderModule acquire_cached( const uint64_t hash )
+{
+    ShaderCache& cache = get_cache();
+
+    auto it = cache.modules.find( hash );
+    if ( it == cache.modules.end() )
+        return VK_NULL_HANDLE;
+
+    it->second.ref_count++;
+    return it->second.module;
+}
+
+}
+
+void init_shader_cache( const std::vector<std::string>& search_paths )
+{
+    if ( device_caches.size() <= get_current_device_index() )
+        device_caches.resize( get_current_device_index() + 1 );
+
+    get_cache().search_paths = search_paths;
+}
+
+void destroy_shader_cache()
+{
+    ShaderCache& cache = get_cache();
+
+    for ( const auto& [hash, cached] : cache.modules )
+    {
+        LOG( "WARNING - Shader module %016llx still holds %u reference(s)!\n", static_cast<unsigned long long>( hash ), cached.ref_count );
+        destroy_shader_module( cached.module );
+    }
+
+    cache = {};
+}
+
+VkShaderModule acquire_shader_module( const std::string_view name )
+{
+    ShaderCache& cache = get_cache();
+
+    const std::string key { name };
+
+    if ( auto it = cache.name_to_hash.find( key ); it != cache.name_to_hash.end() )
+    {
+        const VkShaderModule module = acquire_cached( it->second );
+        if ( module != VK_NULL_HANDLE )
+            return module;
+    }
+
+    const std::string file_name = ( key.ends_with( ".spv" ) ) ? key : key + ".spv";
+    const std::string path = resolve_path( file_name );
+
+    const int fd = open( path.c_str(), O_RDONLY );
+    ASSERT( fd >= 0, "Failed to open shader %s!\n", path.c_str() );
+
+    struct stat file_stat {};
+    ASSERT( fstat( fd, &file_stat ) == 0, "Failed to stat shader %s!\n", path.c_str() );
+
+    const size_t code_size = static_cast<size_t>( file_stat.st_size );
+    ASSERT( code_size >= spirv_header_size && ( code_size % sizeof( uint32_t ) ) == 0, "Shader %s has an invalid SPIR-V size of %zu bytes!\n", path.c_str(), code_size );
+
+    void* const mapped = mmap( nullptr, code_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    ASSERT( mapped != MAP_FAILED, "Failed to map shader %s!\n", path.c_str() );
+
+    const uint32_t* const code = static_cast<const uint32_t*>( mapped );
+    ASSERT( code[0] == spirv_magic, "Shader %s is not SPIR-V (magic %08x)!\n", path.c_str(), code[0] );
+
+    const uint64_t hash = hash_code( static_cast<const uint8_t*>( mapped ), code_size );
+    cache.name_to_hash[key] = hash;
+
+    VkShaderModule module = acquire_cached( hash );
+    if ( module == VK_NULL_HANDLE )
+    {
+        module = create_shader_module( code_size, code );
+        cache.modules[hash] = { .module = module, .ref_count = 1 };
+    }
+
+    munmap( mapped, code_size );
+    return module;
+}
+
+void release_shader_module( const VkShaderModule module )
+{
+    ShaderCache& cache = get_cache();
+
+    auto it = std::find_if( cache.modules.begin(), cache.modules.end(), [&]( const auto& entry ) { return entry.second.module == module; } );
+    ASSERT( it != cache.modules.end(), "Released a shader module not owned by the cache!\n" );
+
+    if ( --it->second.ref_count == 0 )
+    {
+        destroy_shader_module( it->second.module );
+        cache.modules.erase( it );
+    }
+}
+
+}; // vkn
@@ -0,0 +1,17 @@
+#ifndef VKN_SHADER_HPP
+#define VKN_SHADER_HPP
+
+#include <string>
+#include <vector>
+
+// Internal to vkn, the public shader module API is declared in vkn.hpp.
+
+namespace vkn
+{
+
+void init_shader_cache( const std::vector<std::string>& search_paths );
+void destroy_shader_cache();
+
+}; // vkn
+
+#endif // VKN_SHADER_HPP
@@ -0,0 +1,233 @@
+#include "vkn.hpp"
+#include "vkn_submit.hpp"
+#include "defines.hpp"
+
+#include <vector>
+
+namespace vkn
+{
+
+namespace
+{
+
+struct PendingBatch
+{
+    std::vector<VkCommandBufferSubmitInfo> cmd_buff_infos;
+    std::vector<VkSemaphoreSubmitInfo> waits;
+    std::vector<VkSemaphoreSubmitInfo> signals;     // ends with the queue's timeline
+};
+
+struct ScheduledQueue
+{
+    VkQueue queue { VK_NULL_HANDLE };
+    uint32_t queue_family_index { 0 };
+    bool aliased { false };             // shares its VkQueue with an earlier config entry, never selected
+
+    VkSemaphore timeline { VK_NULL_HANDLE };
+    uint64_t next_value { 0 };          // value of the last enqueued batch
+    uint64_t flushed_value { 0 };       // value of the last submitted batch
+
+    std::vector<PendingBatch> pending;
+};
+
+struct Scheduler
+{
+    std::vector<ScheduledQueue> queues;     // one per "queues" config entry
+    uint32_t next_round_robin { 0 };
+};
+
+// Queues belong to one device, so does the scheduler
+static std::vector<Scheduler> device_schedulers;
+
+static Scheduler& get_scheduler()
+{
+    return device_schedulers.at( get_current_device_index() );
+}
+
+static VkSemaphoreSubmitInfo make_semaphore_submit_info( const SemaphoreSubmit& submit )
+{
+    // The legacy stage bits have the same values in VkPipelineStageFlags2
+    const VkSemaphoreSubmitInfo info {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .semaphore = submit.semaphore,
+        .value = submit.value,
+        .stageMask = static_cast<VkPipelineStageFlags2>( submit.stage ),
+        .deviceIndex = 0,
+    };
+
+    return info;
+}
+
+static void flush_queue( ScheduledQueue& scheduled_queue )
+{
+    if ( scheduled_queue.pending.empty() )
+        return;
+
+    std::vector<VkSubmitInfo2> submit_infos;
+    submit_infos.reserve( scheduled_queue.pending.size() );
+
+    for ( const PendingBatch& batch : scheduled_queue.pending )
+    {
+        submit_infos.push_back( {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+            .pNext = nullptr,
+            .flags = 0x0,
+            .waitSemaphoreInfoCount = static_cast<uint32_t>( batch.waits.size() ),
+            .pWaitSemaphoreInfos = batch.waits.data(),
+            .commandBufferInfoCount = static_cast<uint32_t>( batch.cmd_buff_infos.size() ),
+            .pCommandBufferInfos = batch.cmd_buff_infos.data(),
+            .signalSemaphoreInfoCount = static_cast<uint32_t>( batch.signals.size() ),
+            .pSignalSemaphoreInfos = batch.signals.data(),
+        } );
+    }
+
+    VK_CHECK( vkQueueSubmit2( scheduled_queue.queue, static_cast<uint32_t>( submit_infos.size() ), submit_infos.data(), VK_NULL_HANDLE ) );
+
+    scheduled_queue.flushed_value = scheduled_queue.next_value;
+    scheduled_queue.pending.clear();
+}
+
+}
+
+void init_submit_scheduler()
+{
+    if ( device_schedulers.size() <= get_current_device_index() )
+        device_schedulers.resize( get_current_device_index() + 1 );
+
+    Scheduler& scheduler = get_scheduler();
+    scheduler = {};
+    scheduler.queues.resize( get_queue_count() );
+
+    for ( uint32_t i = 0; i < scheduler.queues.size(); i++ )
+    {
+        ScheduledQueue& scheduled_queue = scheduler.queues[i];
+        scheduled_queue.queue = get_queue( i );
+        scheduled_queue.queue_family_index = get_queue_family_index( i );
+        scheduled_queue.timeline = create_timeline_semaphore( 0 );
+
+        for ( uint32_t j = 0; j < i; j++ )
+            scheduled_queue.aliased |= ( scheduler.queues[j].queue == scheduled_queue.queue );
+    }
+}
+
+void destroy_submit_scheduler()
+{
+    Scheduler& scheduler = get_scheduler();
+
+    for ( ScheduledQueue& scheduled_queue : scheduler.queues )
+    {
+        if ( !scheduled_queue.pending.empty() )
+        {
+            LOG( "WARNING - %zu batch(es) were never flushed!\n", scheduled_queue.pending.size() );
+        }
+
+        wait_semaphore( scheduled_queue.timeline, scheduled_queue.flushed_value );
+        destroy_semaphore( scheduled_queue.timeline );
+    }
+
+    scheduler = {};
+}
+
+uint32_t select_queue( const VkQueueFlags required_flags, const uint32_t queue_family_index )
+{
+    Scheduler& scheduler = get_scheduler();
+
+    uint32_t best_queue = UINT32_MAX;
+    uint64_t best_load = UINT64_MAX;
+
+    // Round robin start, so equally loaded queues take turns
+    for ( uint32_t n = 0; n < scheduler.queues.size(); n++ )
+    {
+        const uint32_t i = ( scheduler.next_round_robin + n ) % scheduler.queues.size();
+        const ScheduledQueue& scheduled_queue = scheduler.queues[i];
+
+        if ( scheduled_queue.aliased )
+            continue;
+        if ( queue_family_index != VK_QUEUE_FAMILY_IGNORED && scheduled_queue.queue_family_index != queue_family_index )
+            continue;
+        if ( ( get_queue_family_properties( scheduled_queue.queue_family_index ).queueFlags & required_flags ) != required_flags )
+            continue;
+
+        // Batches enqueued or still executing
+        const uint64_t load = scheduled_queue.next_value - get_semaphore_counter_value( scheduled_queue.timeline );
+        if ( load < best_load )
+        {
+            best_queue = i;
+            best_load = load;
+        }
+    }
+
+    ASSERT( best_queue != UINT32_MAX, "No configured queue supports the requested flags!\n" );
+
+    scheduler.next_round_robin = ( best_queue + 1 ) % scheduler.queues.size();
+    return best_queue;
+}
+
+SubmitTicket enqueue_submit( const uint32_t queue_index, const uint32_t cmd_buff_count, const VkCommandBuffer* const cmd_buffs, const std::vector<SemaphoreSubmit>& waits, const std::vector<SemaphoreSubmit>& signals )
+{
+    ScheduledQueue& scheduled_queue = get_scheduler().queues.at( queue_index );
+
+    PendingBatch batch;
+
+    batch.cmd_buff_infos.reserve( cmd_buff_count );
+    for ( uint32_t i = 0; i < cmd_buff_count; i++ )
+    {
+        batch.cmd_buff_infos.push_back( {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+            .pNext = nullptr,
+            .commandBuffer = cmd_buffs[i],
+            .deviceMask = 0,
+        } );
+    }
+
+    batch.waits.reserve( waits.size() );
+    for ( const SemaphoreSubmit& wait : waits )
+        batch.waits.push_back( make_semaphore_submit_info( wait ) );
+
+    batch.signals.reserve( signals.size() + 1 );
+    for ( const SemaphoreSubmit& signal : signals )
+        batch.signals.push_back( make_semaphore_submit_info( signal ) );
+
+    // Every batch signals its own value, batches complete in submission order on one queue
+    const uint64_t value = ++scheduled_queue.next_value;
+    batch.signals.push_back( make_semaphore_submit_info( { .semaphore = scheduled_queue.timeline, .value = value, .stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT } ) );
+
+    scheduled_queue.pending.push_back( std::move( batch ) );
+
+    return { .queue_index = queue_index, .value = value };
+}
+
+void flush_submits()
+{
+    for ( ScheduledQueue& scheduled_queue : get_scheduler().queues )
+        flush_queue( scheduled_queue );
+}
+
+void flush_submits( const uint32_t queue_index )
+{
+    flush_queue( get_scheduler().queues.at( queue_index ) );
+}
+
+bool is_submit_complete( const SubmitTicket& ticket )
+{
+    return get_semaphore_counter_value( get_scheduler().queues.at( ticket.queue_index ).timeline ) >= ticket.value;
+}
+
+bool wait_submit( const SubmitTicket& ticket, const uint64_t timeout )
+{
+    ScheduledQueue& scheduled_queue = get_scheduler().queues.at( ticket.queue_index );
+
+    // Waiting on a batch that was never submitted would never return
+    if ( scheduled_queue.flushed_value < ticket.value )
+        flush_queue( scheduled_queue );
+
+    return wait_semaphore( scheduled_queue.timeline, ticket.value, timeout );
+}
+
+VkSemaphore get_submit_timeline( const uint32_t queue_index )
+{
+    return get_scheduler().queues.at( queue_index ).timeline;
+}
+
+}; // vkn
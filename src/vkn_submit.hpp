@@ -0,0 +1,14 @@
+#ifndef VKN_SUBMIT_HPP
+#define VKN_SUBMIT_HPP
+
+// Internal to vkn, the public submission scheduler API is declared in vkn.hpp.
+
+namespace vkn
+{
+
+void init_submit_scheduler();
+void destroy_submit_scheduler();
+
+}; // vkn
+
+#endif // VKN_SUBMIT_HPP
@@ -0,0 +1,138 @@
+#include "vkn.hpp"
+#include "vkn_tuning.hpp"
+#include "defines.hpp"
+
+#include "json_parser/json.hpp"
+
+#include <fstream>
+#include <stdio.h>
+
+namespace vkn
+{
+
+namespace
+{
+
+struct Tuning
+{
+    std::string path;
+    nlohmann::json kernels = nlohmann::json::object();    // this device's entry, kernel name -> specialization
+};
+
+// Every device keeps its own entry of the shared tuning file
+static std::vector<Tuning> device_tunings;
+
+static Tuning& get_tuning()
+{
+    return device_tunings.at( get_current_device_index() );
+}
+
+// Results only transfer between identical devices running the same driver
+static std::string get_device_key()
+{
+    const VkPhysicalDeviceIDProperties& id_props = get_physical_device_id_properties();
+
+    std::string key;
+    char hex[3];
+    for ( uint32_t i = 0; i < VK_UUID_SIZE; i++ )
+    {
+        snprintf( hex, sizeof( hex ), "%02x", id_props.deviceUUID[i] );
+        key += hex;
+    }
+
+    return key + "/" + std::to_string( get_physical_device_properties().driverVersion );
+}
+
+static nlohmann::json read_tuning_file( const std::string& path )
+{
+    std::ifstream file( path );
+    if ( !file.is_open() )
+        return nlohmann::json::object();
+
+    const nlohmann::json json_data = nlohmann::json::parse( file, nullptr, false );
+    if ( json_data.is_discarded() || !json_data.is_object() )
+    {
+        LOG( "WARNING - Ignoring malformed tuning file %s\n", path.c_str() );
+        return nlohmann::json::object();
+    }
+
+    return json_data;
+}
+
+}
+
+void init_tuning( const std::string& tuning_path )
+{
+    if ( device_tunings.size() <= get_current_device_index() )
+        device_tunings.resize( get_current_device_index() + 1 );
+
+    Tuning& tuning = get_tuning();
+    tuning = {};
+    tuning.path = tuning_path;
+
+    if ( tuning.path.empty() )
+        return;
+
+    const nlohmann::json json_data = read_tuning_file( tuning.path );
+    const auto it = json_data.find( get_device_key() );
+
+    if ( it != json_data.end() && it->contains( "kernels" ) )
+    {
+        tuning.kernels = it->at( "kernels" );
+        LOG( "Loaded %zu tuned kernel(s) from %s\n", tuning.kernels.size(), tuning.path.c_str() );
+    }
+}
+
+std::optional<ComputeSpecialization> find_tuned_compute_specialization( const std::string_view kernel_name )
+{
+    Tuning& tuning = get_tuning();
+
+    const auto it = tuning.kernels.find( std::string( kernel_name ) );
+    if ( it == tuning.kernels.end() )
+        return std::nullopt;
+
+    return ComputeSpecialization {
+        .local_size_x = it->value( "local_size_x", 0u ),
+        .elements_per_thread = it->value( "elements_per_thread", 0u ),
+        .unroll = it->value( "unroll", 0u ),
+        .vectorized = it->value( "vectorized", true ) ? VK_TRUE : VK_FALSE,
+    };
+}
+
+void set_tuned_compute_specialization( const std::string_view kernel_name, const ComputeSpecialization& specialization )
+{
+    Tuning& tuning = get_tuning();
+
+    tuning.kernels[std::string( kernel_name )] = {
+        { "local_size_x", specialization.local_size_x },
+        { "elements_per_thread", specialization.elements_per_thread },
+        { "unroll", specialization.unroll },
+        { "vectorized", specialization.vectorized == VK_TRUE },
+    };
+}
+
+void save_tuned_compute_specializations()
+{
+    Tuning& tuning = get_tuning();
+
+    ASSERT( !tuning.path.empty(), "Saving tuning results requires a \"tuning_path\" in the device config!\n" );
+
+    // Entries of other devices sharing the file are kept
+    nlohmann::json json_data = read_tuning_file( tuning.path );
+    json_data[get_device_key()] = {
+        { "device_name", get_physical_device_properties().deviceName },
+        { "kernels", tuning.kernels },
+    };
+
+    const std::string tmp_path = tuning.path + ".tmp";
+    {
+        std::ofstream file( tmp_path );
+        ASSERT( file.is_open(), "Failed to open tuning file %s!\n", tmp_path.c_str() );
+        file << json_data.dump( 4 ) << '\n';
+    }
+
+    ASSERT( rename( tmp_path.c_str(), tuning.path.c_str() ) == 0, "Failed to write tuning file %s!\n", tuning.path.c_str() );
+    LOG( "Saved tuned kernels to %s\n", tuning.path.c_str() );
+}
+
+}; // vkn
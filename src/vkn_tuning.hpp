@@ -0,0 +1,20 @@
+#ifndef VKN_TUNING_HPP
+#define VKN_TUNING_HPP
+
+#include "vkn.hpp"
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Internal to vkn, the public tuning API is declared in vkn.hpp.
+
+namespace vkn
+{
+
+void init_tuning( const std::string& tuning_path );
+std::optional<ComputeSpecialization> find_tuned_compute_specialization( const std::string_view kernel_name );
+
+}; // vkn
+
+#endif // VKN_TUNING_HPP
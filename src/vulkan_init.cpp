@@ -6,8 +6,12 @@
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <bit>
 #include <fstream>
 #include <optional>
+#include <sstream>
+#include <string_view>
 #include <unordered_set>
 #include <vector>
 
@@ -33,11 +37,33 @@ void from_json(const nlohmann::json& j, ConfigInfoInstance& c)
     j.at("extensions").get_to(c.extensions);
 }
 
+// Every field is optional. Devices failing a filter are skipped, the rest are ranked by type preference and then by
+// their largest device local heap.
+struct ConfigInfoDeviceSelection
+{
+    std::string prefer = "DISCRETE";    // DISCRETE, INTEGRATED, VIRTUAL, CPU or ANY
+    std::string name;                   // substring of the device name
+    std::string uuid;                   // deviceUUID as 32 hex digits
+    uint64_t min_heap_size = 0;         // bytes of device local memory in one heap
+};
+
+void from_json(const nlohmann::json& j, ConfigInfoDeviceSelection& c)
+{
+    c.prefer = j.value("prefer", "DISCRETE");
+    c.name = j.value("name", "");
+    c.uuid = j.value("uuid", "");
+    c.min_heap_size = j.value("min_heap_size", uint64_t( 0 ));
+}
+
 struct ConfigInfoDevice
 {
     std::vector<std::vector<std::string>> queues;
     std::vector<std::string> layers;
     std::vector<std::string> extensions;
+    std::string pipeline_cache_path;    // optional, empty keeps the pipeline cache in memory only
+    std::string tuning_path;            // optional, autotuned kernel specializations per device
+    ConfigInfoDeviceSelection selection;
+    bool multi_device = false;          // optional, creates a device for every physical device passing the selection
 };
 
 void from_json(const nlohmann::json& j, ConfigInfoDevice& c)
@@ -45,6 +71,10 @@ void from_json(const nlohmann::json& j, ConfigInfoDevice& c)
     j.at("queues").get_to(c.queues);
     j.at("layers").get_to(c.layers);
     j.at("extensions").get_to(c.extensions);
+    c.pipeline_cache_path = j.value("pipeline_cache_path", "");
+    c.tuning_path = j.value("tuning_path", "");
+    c.selection = j.value("selection", ConfigInfoDeviceSelection {});
+    c.multi_device = j.value("multi_device", false);
 }
 
 struct ConfigInfoSwapchain
@@ -147,8 +177,62 @@ static VkSurfaceKHR create_surface( const VkInstance instance, GLFWwindow* const
     return surface;
 }
 
-static VkPhysicalDevice select_physical_device( const VkInstance instance )
+static std::string to_hex( const uint8_t* const bytes, const uint32_t size )
+{
+    std::string hex;
+    char digits[3];
+    for ( uint32_t i = 0; i < size; i++ )
+    {
+        snprintf( digits, sizeof( digits ), "%02x", bytes[i] );
+        hex += digits;
+    }
+    return hex;
+}
+
+static VkDeviceSize get_largest_device_local_heap( const VkPhysicalDevice physical_device )
 {
+    VkPhysicalDeviceMemoryProperties mem_props;
+    vkGetPhysicalDeviceMemoryProperties( physical_device, &mem_props );
+
+    VkDeviceSize largest = 0;
+    for ( uint32_t i = 0; i < mem_props.memoryHeapCount; i++ )
+    {
+        if ( mem_props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT )
+            largest = std::max( largest, mem_props.memoryHeaps[i].size );
+    }
+    return largest;
+}
+
+// Higher is better, the preferred type always outranks the others
+static uint32_t get_device_type_rank( const VkPhysicalDeviceType type, const std::string& prefer )
+{
+    const auto matches = [&]( const VkPhysicalDeviceType preferred_type, const char* const preferred_name ) { return type == preferred_type && prefer == preferred_name; };
+
+    if ( matches( VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, "DISCRETE" ) || matches( VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, "INTEGRATED" ) ||
+         matches( VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU, "VIRTUAL" ) || matches( VK_PHYSICAL_DEVICE_TYPE_CPU, "CPU" ) )
+        return 5;
+
+    switch ( type )
+    {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            return 4;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            return 3;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+            return 2;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Returns the devices passing the selection filters, best first. Only the best one unless multi_device is set.
+static std::vector<VkPhysicalDevice> select_physical_devices( const VkInstance instance, const ConfigInfoDeviceSelection& selection, const bool multi_device )
+{
+    ASSERT( selection.prefer == "DISCRETE" || selection.prefer == "INTEGRATED" || selection.prefer == "VIRTUAL" || selection.prefer == "CPU" || selection.prefer == "ANY",
+        "Invalid device selection preference %s in config file!\n", selection.prefer.c_str() );
+
     uint32_t num_physical_devices = 0;
     vkEnumeratePhysicalDevices( instance, &num_physical_devices, nullptr );
     std::vector<VkPhysicalDevice> physical_devices( num_physical_devices );
@@ -170,16 +254,32 @@ static VkPhysicalDevice select_physical_device( const VkInstance instance )
         return ss.str();
     };
 
+    struct Candidate
+    {
+        uint32_t index { 0 };
+        uint32_t type_rank { 0 };
+        VkDeviceSize heap_size { 0 };
+    };
+
+    std::vector<Candidate> candidates;
+
     for ( uint32_t i = 0; i < num_physical_devices; i++ )
     {
-        VkPhysicalDeviceProperties physical_device_props;
-        vkGetPhysicalDeviceProperties( physical_devices[i], &physical_device_props );
+        VkPhysicalDeviceIDProperties id_props { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES };
+        VkPhysicalDeviceProperties2 props2 { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &id_props };
+        vkGetPhysicalDeviceProperties2( physical_devices[i], &props2 );
+        const VkPhysicalDeviceProperties& physical_device_props = props2.properties;
+
+        const std::string uuid = to_hex( id_props.deviceUUID, VK_UUID_SIZE );
+        const VkDeviceSize heap_size = get_largest_device_local_heap( physical_devices[i] );
 
         std::stringstream ss;
 
         ss << "Device ID " << i << '\n';
         ss << "\tName: " << physical_device_props.deviceName << '\n';
         ss << "\tType: " << physical_device_props.deviceType << '\n';
+        ss << "\tUUID: " << uuid << '\n';
+        ss << "\tLargest Device Local Heap: " << ( heap_size >> 20 ) << " MiB\n";
 
         uint32_t num_queue_family_props = 0;
         vkGetPhysicalDeviceQueueFamilyProperties( physical_devices[i], &num_queue_family_props, nullptr );
@@ -188,86 +288,162 @@ static VkPhysicalDevice select_physical_device( const VkInstance instance )
 
         ss << "\tNum Queue Families: " << num_queue_family_props << '\n';
 
+        bool has_compute = false;
         for ( uint32_t j = 0; j < num_queue_family_props; j++ )
         {
             ss << "\t\tQueue Family " << j << '\n';
-            ss << "\t\t\tQueue Count: " << queue_family_props[i].queueCount << '\n';
-            ss << "\t\t\tQueue Flags: " << queue_flags_to_str( queue_family_props[i].queueFlags ) << '\n';
+            ss << "\t\t\tQueue Count: " << queue_family_props[j].queueCount << '\n';
+            ss << "\t\t\tQueue Flags: " << queue_flags_to_str( queue_family_props[j].queueFlags ) << '\n';
+            has_compute |= ( queue_family_props[j].queueFlags & VK_QUEUE_COMPUTE_BIT ) != 0;
         }
 
+        const char* rejection = nullptr;
+        if ( physical_device_props.apiVersion < VK_API_VERSION_1_3 )
+            rejection = "Vulkan 1.3 not supported";
+        else if ( !has_compute )
+            rejection = "no compute queue";
+        else if ( !selection.name.empty() && std::string_view( physical_device_props.deviceName ).find( selection.name ) == std::string_view::npos )
+            rejection = "name does not match";
+        else if ( !selection.uuid.empty() && uuid != selection.uuid )
+            rejection = "UUID does not match";
+        else if ( heap_size < selection.min_heap_size )
+            rejection = "device local heap too small";
+
+        if ( rejection )
+            ss << "\tRejected: " << rejection << '\n';
+        else
+            candidates.push_back( { .index = i, .type_rank = get_device_type_rank( physical_device_props.deviceType, selection.prefer ), .heap_size = heap_size } );
+
         LOG( "%s\n", ss.str().c_str() );
     }
 
-    const uint32_t idx = 0;
-    LOG("Selecting Physical Device: %u\n", idx);
+    ASSERT( !candidates.empty(), "No physical device matches the device selection in the config file!\n" );
+
+    std::stable_sort( candidates.begin(), candidates.end(), []( const Candidate& a, const Candidate& b )
+    {
+        return ( a.type_rank != b.type_rank ) ? a.type_rank > b.type_rank : a.heap_size > b.heap_size;
+    } );
+
+    if ( !multi_device )
+        candidates.resize( 1 );
+
+    std::vector<VkPhysicalDevice> selected;
+    for ( const Candidate& candidate : candidates )
+    {
+        LOG( "Selecting Physical Device: %u\n", candidate.index );
+        selected.push_back( physical_devices[candidate.index] );
+    }
+
+    return selected;
+}
 
-    return physical_devices[idx];
+struct QueueSelection
+{
+    uint32_t queue_family_index = UINT32_MAX;
+    uint32_t queue_index = 0;  // index within the family
+};
+
+static VkQueueFlags parse_queue_flags( const std::vector<std::string>& queue_flag_list, bool& present_requested )
+{
+    VkQueueFlags flags = 0x0;
+    for ( const std::string& queue_flag_str : queue_flag_list )
+    {
+        if ( queue_flag_str == "GRAPHICS" )
+            flags |= VK_QUEUE_GRAPHICS_BIT;
+        if ( queue_flag_str == "COMPUTE" )
+            flags |= VK_QUEUE_COMPUTE_BIT;
+        if ( queue_flag_str == "TRANSFER" )
+            flags |= VK_QUEUE_TRANSFER_BIT;
+        if ( queue_flag_str == "SPARSE" )
+            flags |= VK_QUEUE_SPARSE_BINDING_BIT;
+        if ( queue_flag_str == "PRESENT" )
+            present_requested = true;
+    }
+    return flags;
 }
 
-static uint32_t select_queue_family_index( const nlohmann::json& json_data, const VkPhysicalDevice physical_device, const std::optional<VkSurfaceKHR> surface )
+// Maps every "queues" entry to the family that satisfies it with the fewest extra capabilities, so a [ "TRANSFER" ]
+// entry lands on a DMA-only family and a [ "COMPUTE" ] entry on an async compute family when the device has them.
+// Families hand out distinct queues until they run out, after which the entry shares the family's last queue.
+static std::vector<QueueSelection> select_queue_families( const nlohmann::json& json_data, const VkPhysicalDevice physical_device, const std::optional<VkSurfaceKHR> surface )
 {   
     uint32_t num_queue_family_props = 0;
     vkGetPhysicalDeviceQueueFamilyProperties( physical_device, &num_queue_family_props, nullptr );
     std::vector<VkQueueFamilyProperties> queue_family_props( num_queue_family_props );
     vkGetPhysicalDeviceQueueFamilyProperties( physical_device, &num_queue_family_props, queue_family_props.data() );
 
-    bool present_requested = false;
-    const VkQueueFlags requested_queue_flags = [&]()
-    {
-        VkQueueFlags flags = 0x0;
-        for ( const std::vector<std::string>& queue_flag_list : json_data.at("device").at("queues") ) 
-        {
-            for ( const std::string& queue_flag_str : queue_flag_list )
-            {
-                if ( queue_flag_str == "GRAPHICS" )
-                    flags |= VK_QUEUE_GRAPHICS_BIT;
-                if ( queue_flag_str == "COMPUTE" )
-                    flags |= VK_QUEUE_COMPUTE_BIT;
-                if ( queue_flag_str == "TRANSFER" )
-                    flags |= VK_QUEUE_TRANSFER_BIT;
-                if ( queue_flag_str == "SPARSE" )
-                    flags |= VK_QUEUE_SPARSE_BINDING_BIT;
-                if ( queue_flag_str == "PRESENT" )
-                    present_requested = true;
-            }
-        }
+    const std::vector<std::vector<std::string>> queue_configs = json_data.at("device").at("queues").get<std::vector<std::vector<std::string>>>();
 
-        return flags;
-    }();
+    std::vector<uint32_t> assigned_queue_counts( num_queue_family_props, 0 );
+    std::vector<QueueSelection> selections;
+    selections.reserve( queue_configs.size() );
 
-    if ( present_requested )
-        assert( surface.has_value() );
-
-    if ( surface.has_value() )
-        assert( present_requested );
+    bool any_present_requested = false;
 
-    uint32_t i = 0;
-    for ( ; i < queue_family_props.size(); i++ )
+    for ( uint32_t q = 0; q < queue_configs.size(); q++ )
     {
-        const VkQueueFamilyProperties& props = queue_family_props[i];
+        bool present_requested = false;
+        const VkQueueFlags requested_queue_flags = parse_queue_flags( queue_configs[q], present_requested );
+        any_present_requested |= present_requested;
 
-        if ( ( props.queueFlags & requested_queue_flags ) == requested_queue_flags )
+        if ( present_requested )
+            assert( surface.has_value() );
+
+        uint32_t best_family = UINT32_MAX;
+        uint32_t best_extra_caps = UINT32_MAX;
+        bool best_has_free_queue = false;
+
+        for ( uint32_t i = 0; i < queue_family_props.size(); i++ )
         {
-            // We have found a queue family that supports all of our requests (excluding present)
+            const VkQueueFamilyProperties& props = queue_family_props[i];
+
+            // Graphics and compute families always support transfers, even when they do not advertise it
+            VkQueueFlags family_flags = props.queueFlags & ( VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_SPARSE_BINDING_BIT );
+            if ( family_flags & ( VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT ) )
+                family_flags |= VK_QUEUE_TRANSFER_BIT;
+
+            if ( ( family_flags & requested_queue_flags ) != requested_queue_flags )
+                continue;
 
             if ( present_requested )
             {
                 VkBool32 queue_family_supports_present = false;
                 VK_CHECK( vkGetPhysicalDeviceSurfaceSupportKHR( physical_device, i, surface.value(), &queue_family_supports_present ) );
 
-                if ( queue_family_supports_present )
-                    break;
+                if ( !queue_family_supports_present )
+                    continue;
+            }
+
+            const uint32_t extra_caps = static_cast<uint32_t>( std::popcount( family_flags & ~requested_queue_flags ) );
+            const bool has_free_queue = assigned_queue_counts[i] < props.queueCount;
+
+            // A family with a free queue always beats one we would have to share, then the most specialised family wins
+            if ( ( has_free_queue && !best_has_free_queue ) || ( has_free_queue == best_has_free_queue && extra_caps < best_extra_caps ) )
+            {
+                best_family = i;
+                best_extra_caps = extra_caps;
+                best_has_free_queue = has_free_queue;
             }
-            else
-                break;
         }
+
+        ASSERT( best_family != UINT32_MAX, "No queue family satisfies queue %u in config file!\n", q );
+
+        QueueSelection selection {
+            .queue_family_index = best_family,
+            .queue_index = best_has_free_queue ? assigned_queue_counts[best_family]++ : queue_family_props[best_family].queueCount - 1,
+        };
+
+        LOG( "Queue %u -> Queue Family %u, Index %u%s\n", q, selection.queue_family_index, selection.queue_index, best_has_free_queue ? "" : " (shared)" );
+        selections.push_back( selection );
     }
 
-    LOG( "Selecing Queue Family Index: %u\n", i );
-    return i;
+    if ( surface.has_value() )
+        assert( any_present_requested );
+
+    return selections;
 }
 
-static VkDevice create_device( const nlohmann::json& json_data, const VkPhysicalDevice physical_device, const uint32_t queue_family_idx, uint32_t& requested_queue_count )
+static VkDevice create_device( const nlohmann::json& json_data, const VkPhysicalDevice physical_device, const std::vector<QueueSelection>& queue_selections )
 {
     const ConfigInfoDevice config_info = json_data.at("device").get<ConfigInfoDevice>();
 
@@ -281,20 +457,63 @@ static VkDevice create_device( const nlohmann::json& json_data, const VkPhysical
 
     const std::vector<float> queue_priorities( config_info.queues.size(), 1.0f );
 
-    const VkDeviceQueueCreateInfo queue_create_info = {
-        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-        .queueFamilyIndex = queue_family_idx,
-        .queueCount = static_cast<uint32_t>( config_info.queues.size() ),
-        .pQueuePriorities = queue_priorities.data()
+    // One create info per distinct family, sized by the highest queue index handed out from it
+    std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
+    for ( const QueueSelection& selection : queue_selections )
+    {
+        auto it = std::find_if( queue_create_infos.begin(), queue_create_infos.end(), [&]( const VkDeviceQueueCreateInfo& info ) { return info.queueFamilyIndex == selection.queue_family_index; } );
+
+        if ( it == queue_create_infos.end() )
+        {
+            queue_create_infos.push_back( {
+                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                .queueFamilyIndex = selection.queue_family_index,
+                .queueCount = 0,
+                .pQueuePriorities = queue_priorities.data()
+            } );
+            it = queue_create_infos.end() - 1;
+        }
+
+        it->queueCount = std::max( it->queueCount, selection.queue_index + 1 );
+    }
+
+    // Core features the engine relies on, checked against what the device supports before enabling them
+    VkPhysicalDeviceVulkan13Features supported_features_13 { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES };
+    VkPhysicalDeviceVulkan12Features supported_features_12 { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES, .pNext = &supported_features_13 };
+    VkPhysicalDeviceFeatures2 supported_features { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &supported_features_12 };
+    vkGetPhysicalDeviceFeatures2( physical_device, &supported_features );
+
+    ASSERT( supported_features_12.timelineSemaphore, "Device does not support timeline semaphores!\n" );
+    ASSERT( supported_features_12.hostQueryReset, "Device does not support host query reset!\n" );
+    ASSERT( supported_features_13.synchronization2, "Device does not support synchronization2!\n" );
+
+    // Pointer passing kernels, buffer addresses in push constants
+    ASSERT( supported_features_12.bufferDeviceAddress, "Device does not support buffer device addresses!\n" );
+
+    VkPhysicalDeviceVulkan13Features features_13 {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+        .pNext = nullptr,
+        .synchronization2 = VK_TRUE,
     };
 
-    requested_queue_count = queue_create_info.queueCount;
+    VkPhysicalDeviceVulkan12Features features_12 {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .pNext = &features_13,
+        .hostQueryReset = VK_TRUE,
+        .timelineSemaphore = VK_TRUE,
+        .bufferDeviceAddress = VK_TRUE,
+    };
+
+    const VkPhysicalDeviceFeatures2 features {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &features_12,
+    };
 
     const VkDeviceCreateInfo create_info = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .pNext = nullptr,
-        .queueCreateInfoCount = 1,
-        .pQueueCreateInfos = &queue_create_info,
+        .pNext = &features,
+        .queueCreateInfoCount = static_cast<uint32_t>( queue_create_infos.size() ),
+        .pQueueCreateInfos = queue_create_infos.data(),
         .enabledLayerCount = static_cast<uint32_t>(layers.size()),
         .ppEnabledLayerNames = (layers.size() == 0) ? nullptr : layers.data(),
         .enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
@@ -307,12 +526,12 @@ static VkDevice create_device( const nlohmann::json& json_data, const VkPhysical
     return device;
 }
 
-static std::vector<VkQueue> get_queues( const VkDevice device, const uint32_t queue_family_index, const uint32_t queue_count )
+static std::vector<VkQueue> get_queues( const VkDevice device, const std::vector<QueueSelection>& queue_selections )
 {
-   std::vector<VkQueue> queues( queue_count, VK_NULL_HANDLE );
-   for ( uint32_t i = 0; i < queue_count; i++ )
+   std::vector<VkQueue> queues( queue_selections.size(), VK_NULL_HANDLE );
+   for ( uint32_t i = 0; i < queue_selections.size(); i++ )
    {
-       vkGetDeviceQueue( device, queue_family_index, i, &queues[i] );
+       vkGetDeviceQueue( device, queue_selections[i].queue_family_index, queue_selections[i].queue_index, &queues[i] );
    }
    return queues;
 }
@@ -584,35 +803,29 @@ static std::vector<VkImageView> create_swapchain_image_views(const VkDevice vk_d
 
 
 
-VulkanCoreInfo vulkan_init( const std::string_view json_path )
+static std::vector<std::string> get_shader_search_paths( const nlohmann::json& json_data )
 {
-    std::ifstream file( json_path.data() );
-    ASSERT( file.is_open(), "Failed to open init config file: %s\n", json_path.data() );
-
-    const nlohmann::json json_data = nlohmann::json::parse(file);
+    std::vector<std::string> search_paths = json_data.value( "shader_search_paths", std::vector<std::string>{} );
 
-    file.close();
+    // The build's SPIR-V output directory is always searched last
+#ifdef SPIRV_OUTPUT_DIR
+    search_paths.push_back( SPIRV_OUTPUT_DIR );
+#endif
 
-    // We do not require a window/surface/swapchain. This is to support headless or compute-only applications.
-    std::optional<SwapchainInfo> swapchain_info = ( json_data.find( "swapchain" ) == json_data.end() ) ? std::nullopt : std::make_optional<SwapchainInfo>();
-
-    const VkInstance instance = create_instance( json_data );
-    
-    if ( swapchain_info.has_value() )
-    {
-        swapchain_info->glfw_window = init_glfw( json_data );
-        swapchain_info->surface = create_surface( instance, swapchain_info->glfw_window );
-    }
+    return search_paths;
+}
 
-    const VkPhysicalDevice physical_device = select_physical_device( instance );
+static VulkanCoreInfo init_device( const nlohmann::json& json_data, const VkInstance instance, const VkPhysicalDevice physical_device, std::optional<SwapchainInfo> swapchain_info )
+{
+    // Every "queues" entry gets its own family where possible, so transfers and async compute can run on separate hardware queues.
+    const std::vector<QueueSelection> queue_selections = select_queue_families( json_data, physical_device, swapchain_info.has_value() ? std::make_optional<VkSurfaceKHR>( swapchain_info->surface ) : std::nullopt ); 
 
-    // We currently only support single queue family applications. You can however, create and use multiple 
-    // queues within the same queue family.
-    const uint32_t queue_family_index = select_queue_family_index( json_data, physical_device, swapchain_info.has_value() ? std::make_optional<VkSurfaceKHR>( swapchain_info->surface ) : std::nullopt ); 
+    const VkDevice device = create_device( json_data, physical_device, queue_selections );
+    std::vector<VkQueue> queues = get_queues( device, queue_selections );
 
-    uint32_t requested_queue_count = 0;
-    const VkDevice device = create_device( json_data, physical_device, queue_family_index, requested_queue_count );
-    std::vector<VkQueue> queues = get_queues( device, queue_family_index, requested_queue_count );
+    std::vector<uint32_t> queue_family_indices( queue_selections.size() );
+    for ( uint32_t i = 0; i < queue_selections.size(); i++ )
+        queue_family_indices[i] = queue_selections[i].queue_family_index;
 
     if ( swapchain_info.has_value() )
     {
@@ -630,15 +843,93 @@ VulkanCoreInfo vulkan_init( const std::string_view json_path )
     VkPhysicalDeviceMemoryProperties physical_device_memory_properties;
     vkGetPhysicalDeviceMemoryProperties(physical_device, &physical_device_memory_properties);
 
+    VkPhysicalDeviceMaintenance4Properties physical_device_maintenance4_properties {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAINTENANCE_4_PROPERTIES,
+        .pNext = nullptr,
+    };
+
+    VkPhysicalDeviceIDProperties physical_device_id_properties {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES,
+        .pNext = &physical_device_maintenance4_properties,
+    };
+
+    VkPhysicalDeviceSubgroupProperties physical_device_subgroup_properties {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,
+        .pNext = &physical_device_id_properties,
+    };
+
+    VkPhysicalDeviceProperties2 physical_device_properties2 {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &physical_device_subgroup_properties,
+    };
+    vkGetPhysicalDeviceProperties2(physical_device, &physical_device_properties2);
+    physical_device_subgroup_properties.pNext = nullptr;
+    physical_device_id_properties.pNext = nullptr;
+
+    uint32_t queue_family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties( physical_device, &queue_family_count, nullptr );
+    std::vector<VkQueueFamilyProperties> queue_family_properties( queue_family_count );
+    vkGetPhysicalDeviceQueueFamilyProperties( physical_device, &queue_family_count, queue_family_properties.data() );
+
+    const ConfigInfoDevice config_info = json_data.at( "device" ).get<ConfigInfoDevice>();
+
     const VulkanCoreInfo core_info {
         .instance = instance,
         .physical_device = physical_device,
-        .queue_family_index = queue_family_index,
+        .queue_family_index = queue_family_indices.at( 0 ),
+        .queue_family_indices = queue_family_indices,
         .device = device,
         .queues = queues,
         .swapchain_info = swapchain_info,
-        .physical_device_memory_properties = physical_device_memory_properties
+        .physical_device_memory_properties = physical_device_memory_properties,
+        .physical_device_properties = physical_device_properties2.properties,
+        .physical_device_subgroup_properties = physical_device_subgroup_properties,
+        .physical_device_id_properties = physical_device_id_properties,
+        .physical_device_maintenance4_properties = physical_device_maintenance4_properties,
+        .queue_family_properties = queue_family_properties,
+        .pipeline_cache_path = config_info.pipeline_cache_path,
+        .tuning_path = config_info.tuning_path,
+        .shader_search_paths = get_shader_search_paths( json_data ),
     };
 
     return core_info;
-}
\ No newline at end of file
+}
+
+std::vector<VulkanCoreInfo> vulkan_init( const std::string_view json_path )
+{
+    std::ifstream file( json_path.data() );
+    ASSERT( file.is_open(), "Failed to open init config file: %s\n", json_path.data() );
+
+    const nlohmann::json json_data = nlohmann::json::parse(file);
+
+    file.close();
+
+    // We do not require a window/surface/swapchain. This is to support headless or compute-only applications.
+    std::optional<SwapchainInfo> swapchain_info = ( json_data.find( "swapchain" ) == json_data.end() ) ? std::nullopt : std::make_optional<SwapchainInfo>();
+
+    const ConfigInfoDevice config_info = json_data.at( "device" ).get<ConfigInfoDevice>();
+    ASSERT( !config_info.multi_device || !swapchain_info.has_value(), "Multi device mode requires a headless config!\n" );
+
+    const VkInstance instance = create_instance( json_data );
+    
+    if ( swapchain_info.has_value() )
+    {
+        swapchain_info->glfw_window = init_glfw( json_data );
+        swapchain_info->surface = create_surface( instance, swapchain_info->glfw_window );
+    }
+
+    const std::vector<VkPhysicalDevice> physical_devices = select_physical_devices( instance, config_info.selection, config_info.multi_device );
+
+    std::vector<VulkanCoreInfo> core_infos;
+    for ( uint32_t i = 0; i < physical_devices.size(); i++ )
+    {
+        // The swapchain always lives on the best device
+        core_infos.push_back( init_device( json_data, instance, physical_devices[i], ( i == 0 ) ? swapchain_info : std::nullopt ) );
+
+        // Caches are only valid for one device, every further device gets its own file
+        if ( i > 0 && !core_infos.back().pipeline_cache_path.empty() )
+            core_infos.back().pipeline_cache_path += "." + std::to_string( i );
+    }
+
+    return core_infos;
+}
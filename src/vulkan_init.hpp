@@ -3,6 +3,7 @@
 
 #include <vulkan/vulkan.h>
 
+#include <string>
 #include <string_view>
 #include <vector>
 #include <optional>
@@ -25,15 +26,27 @@ struct VulkanCoreInfo
 {
     VkInstance instance = VK_NULL_HANDLE;
     VkPhysicalDevice physical_device = VK_NULL_HANDLE;
-    uint32_t queue_family_index = UINT32_MAX;
+    uint32_t queue_family_index = UINT32_MAX;       // family of queue 0
+    std::vector<uint32_t> queue_family_indices;     // family of every queue, in config order
     VkDevice device = VK_NULL_HANDLE;
     std::vector<VkQueue> queues;
 
     std::optional<SwapchainInfo> swapchain_info { std::nullopt };
 
     VkPhysicalDeviceMemoryProperties physical_device_memory_properties;
+    VkPhysicalDeviceProperties physical_device_properties;
+    VkPhysicalDeviceSubgroupProperties physical_device_subgroup_properties;
+    VkPhysicalDeviceIDProperties physical_device_id_properties;
+    VkPhysicalDeviceMaintenance4Properties physical_device_maintenance4_properties;
+    std::vector<VkQueueFamilyProperties> queue_family_properties;
+
+    std::string pipeline_cache_path;
+    std::string tuning_path;
+    std::vector<std::string> shader_search_paths;
 };
 
-VulkanCoreInfo vulkan_init( const std::string_view json_path );
+// One entry per selected physical device, best first. All of them share the instance, only the first one
+// owns the swapchain.
+std::vector<VulkanCoreInfo> vulkan_init( const std::string_view json_path );
 
 #endif // VULKAN_INIT_HPP
\ No newline at end of file